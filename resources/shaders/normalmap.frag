@@ -5,6 +5,7 @@
 in vec3 world_pos;
 in vec3 world_norm;
 in vec2 uv;
+in vec3 object_dir;
 
 // Normal Mapping
 in vec3 cam_pos_tangent_space;
@@ -32,6 +33,13 @@ struct Material {
 uniform Material material;
 uniform sampler2D tex;
 
+// Procedural color maps, looked up by direction from the planet's center
+uniform samplerCube cube_tex;
+uniform bool use_cube_tex;
+
+// The virtual texture and the cloud layer, virtualTexture() and addClouds(), come from
+// planetsurface.glsl, which ShaderLoader inserts ahead of this file
+
 struct Light {
     int type;
     vec3 color;
@@ -45,7 +53,7 @@ struct Light {
 uniform Light lights[MAX_LIGHTS];
 uniform int num_lights;
 
-// Normal Mapping
+// Normal Mapping: RG8 tangent-space x and y, z is rebuilt since the normal has unit length
 uniform sampler2D normal_map;
 uniform bool enable_normal_mapping;
 
@@ -69,7 +77,12 @@ void main() {
         real_uv[1] *= material.repeatV;
     }
 
-    vec4 tex_color = texture(tex, real_uv);
+    vec4 tex_color = use_cube_tex ? texture(cube_tex, object_dir) : texture(tex, real_uv);
+    if (use_virtual_tex) {
+        tex_color = virtualTexture(normalize(object_dir));
+    }
+
+    tex_color = addClouds(tex_color, uv);
 
     frag_color = vec4(material.blend * vec3(tex_color), 1);
 
@@ -77,8 +90,8 @@ void main() {
     vec3 cam_pos = camera_pos; // Not Used
     // Normal Mapping
     if (enable_normal_mapping) {
-        norm = texture(normal_map, real_uv).rgb;
-        norm = normalize(norm * 2.0 - 1.0);
+        vec2 xy = texture(normal_map, real_uv).rg * 2.0 - 1.0;
+        norm = vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0)));
         pos = pos_tangent_space;
         cam_pos = cam_pos_tangent_space;
     }
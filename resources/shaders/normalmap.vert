@@ -11,6 +11,7 @@ layout (location = 4) in vec3 bitangent;
 out vec3 world_pos;
 out vec3 world_norm;
 out vec2 uv;
+out vec3 object_dir;
 
 // Normal Mapping
 out vec3 cam_pos_tangent_space;
@@ -31,6 +32,7 @@ void main() {
     world_pos = vec3(model * vec4(object_pos, 1.0));
     world_norm = model3invt * object_norm;
     uv = uv_in;
+    object_dir = object_pos;
 
     gl_Position = proj_view * vec4(world_pos, 1.0);
 
@@ -7,6 +7,7 @@ layout(location = 2) in vec2 uv_in;
 out vec3 world_pos;
 out vec3 world_norm;
 out vec2 uv;
+out vec3 object_dir;
 
 uniform mat4 model;
 
@@ -20,6 +21,7 @@ void main() {
     world_pos = vec3(model * vec4(object_pos, 1.0));
     world_norm = model3invt * object_norm;
     uv = uv_in;
+    object_dir = object_pos;
     
     gl_Position = proj_view * vec4(world_pos, 1.0);
 }
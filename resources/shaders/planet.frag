@@ -5,6 +5,7 @@
 in vec3 world_pos;
 in vec3 world_norm;
 in vec2 uv;
+in vec3 object_dir;
 
 out vec4 frag_color;
 
@@ -28,6 +29,13 @@ struct Material {
 uniform Material material;
 uniform sampler2D tex;
 
+// Procedural color maps, looked up by direction from the planet's center
+uniform samplerCube cube_tex;
+uniform bool use_cube_tex;
+
+// The virtual texture and the cloud layer, virtualTexture() and addClouds(), come from
+// planetsurface.glsl, which ShaderLoader inserts ahead of this file
+
 struct Light {
     int type;
     vec3 color;
@@ -61,7 +69,12 @@ void main() {
         real_uv[1] *= material.repeatV;
     }
 
-    vec4 tex_color = texture(tex, real_uv);
+    vec4 tex_color = use_cube_tex ? texture(cube_tex, object_dir) : texture(tex, real_uv);
+    if (use_virtual_tex) {
+        tex_color = virtualTexture(normalize(object_dir));
+    }
+
+    tex_color = addClouds(tex_color, uv);
 
     frag_color = vec4(material.blend * vec3(tex_color), 1);
 
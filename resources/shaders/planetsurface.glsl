@@ -0,0 +1,61 @@
+// Color sources shared by the planet shaders, inserted after their #version line by ShaderLoader
+
+// Sparse virtual color map of the orbited planet, see VirtualTexture: an atlas of pages, and a
+// page table whose level l holds, for every page of that level, the atlas slot and the level of
+// the page shown in its place
+uniform sampler2D vt_atlas;
+uniform usampler2D vt_pages;
+uniform int vt_levels;
+uniform int vt_pages_per_face;
+uniform float vt_page_texels;
+uniform float vt_slot_texels;
+uniform float vt_atlas_texels;
+uniform bool use_virtual_tex;
+
+// Animated cloud coverage over the sphere's uv mapping, a crossfade of two keyframes, see CloudLayer
+uniform sampler2D cloud_prev;
+uniform sampler2D cloud_next;
+uniform float cloud_blend;
+uniform float cloud_drift;
+uniform bool use_clouds;
+
+vec4 virtualTexture(vec3 dir) {
+    // Face and position on it, selected as for cube map sampling
+    vec3 a = abs(dir);
+    int face;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = dir.x > 0 ? 0 : 1;
+        st = vec2(dir.x > 0 ? -dir.z : dir.z, -dir.y) / a.x;
+    } else if (a.y >= a.z) {
+        face = dir.y > 0 ? 2 : 3;
+        st = vec2(dir.x, dir.y > 0 ? dir.z : -dir.z) / a.y;
+    } else {
+        face = dir.z > 0 ? 4 : 5;
+        st = vec2(dir.z > 0 ? dir.x : -dir.x, -dir.y) / a.z;
+    }
+    vec2 face_uv = st * 0.5 + 0.5;
+
+    // Coarsest level whose texels, about 2 / face size radians across, are no larger than a pixel
+    float pixel = max(length(dFdx(dir)), length(dFdy(dir)));
+    float finest = vt_page_texels * vt_pages_per_face;
+    int level = clamp(int(floor(log2(pixel * finest / 2))), 0, vt_levels - 1);
+
+    int pages = vt_pages_per_face >> level;
+    ivec2 page = min(ivec2(face_uv * pages), ivec2(pages - 1));
+    uvec4 entry = texelFetch(vt_pages, ivec2(face * pages + page.x, page.y), level);
+
+    // Position within the resident page, inside its slot's border
+    int resident = vt_pages_per_face >> int(entry.b);
+    vec2 local = face_uv * resident - vec2(min(ivec2(face_uv * resident), ivec2(resident - 1)));
+    vec2 texel = vec2(entry.rg) * vt_slot_texels + (vt_slot_texels - vt_page_texels) / 2 + local * vt_page_texels;
+    return textureLod(vt_atlas, texel / vt_atlas_texels, 0);
+}
+
+// The surface's color under the cloud layer at uv, if it is clouded
+vec4 addClouds(vec4 color, vec2 uv) {
+    if (!use_clouds) return color;
+    vec2 cloud_uv = vec2(uv.x + cloud_drift, uv.y);
+    float coverage = mix(texture(cloud_prev, cloud_uv).r, texture(cloud_next, cloud_uv).r, cloud_blend);
+    return mix(color, vec4(1), coverage);
+}
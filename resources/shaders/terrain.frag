@@ -0,0 +1,309 @@
+#version 330 core
+
+// Bakes a planet color map: the same fractal noise, craters and palette tables as
+// TerrainGenerator::generateColorRows(), evaluated once per texel of the bound FBO.
+
+out vec4 frag_color;
+
+const float PI = 3.14159265;
+
+uniform sampler2D gradients;    // NoiseTable as a (size x 1) RGB32F texture
+uniform int mask;               // size - 1
+uniform int resolution;         // the map is (2 * resolution) x resolution texels
+uniform bool banded;
+uniform sampler2D palette_ramp; // PaletteRamp texels as a (PaletteRamp::SIZE x 1) RGBA8 texture
+uniform float ramp_min;
+uniform float ramp_scale;
+uniform int octave_count;       // TerrainJob::octaves() of the map
+uniform float octave_freq[12];
+uniform float octave_amp[12];
+uniform int octave_wrap;        // Octaves::wrap, period of the 2:1 map's noise along its columns
+uniform bool simplex;           // NoiseBasis::SIMPLEX rather than Perlin noise
+uniform sampler2D wrap_columns; // RG32F: a simplex 2:1 map's columns on its cylinder, see SimplexKernel::wrapColumns()
+uniform int face;               // cube map face being rendered, or -1 for the 2:1 map
+
+// BiomeTable of a job with biomes, and the noise channels its climate is derived from
+uniform bool biomes;
+uniform sampler2D biome_table;  // RGBA8, BiomeTable::SIZE x BiomeTable::SIZE
+uniform int biome_octaves;      // TerrainGenerator::BIOME_OCTAVES
+uniform int channel_offset;     // NoiseTable::CHANNEL_OFFSET
+
+// Crater layer of the job, see Craters; none if crater_count is 0
+uniform int crater_count;
+uniform float crater_freq[4];
+uniform float crater_depth[4];
+uniform float crater_density;
+uniform int crater_channel;     // NoiseTable::MAX_CHANNELS, the channel of the first scale's cells
+
+// TerrainJob::sampledOnSphere(): the 2:1 map is sampled at its texels' directions too
+uniform bool sphere;
+
+// BandSynthesizer tables of a banded map, as one-row textures
+uniform sampler2D band_columns; // RG32F: weight, wobble per column
+uniform sampler2D band_rows;    // RG32F: peak, swirl per row
+uniform sampler2D band_ramp;    // RGBA8 band colors of shifted rows [-band_pad, resolution + band_pad)
+uniform int band_pad;
+uniform float band_scale;
+
+float ease(float a) {
+    return a * a * (3 - 2 * a);
+}
+
+vec2 gradient(int row, int col) {
+    return texelFetch(gradients, ivec2((row * 41 + col * 43) & mask, 0), 0).xy;
+}
+
+// Gradient of noise channel `channel` at a 3D lattice corner, see NoiseTable::channelHash()
+vec3 gradient(int row, int col, int layer, int channel) {
+    return texelFetch(gradients, ivec2((row * 41 + col * 43 + layer * 47 + channel * channel_offset) & mask, 0), 0).xyz;
+}
+
+float perlin(float x, float y, int wrap_mask) {
+    int base_x = int(floor(x));
+    int base_y = int(floor(y));
+    // Lattice columns repeat every wrap_mask + 1, see PerlinKernel::perlinWrapped()
+    int col = base_y & wrap_mask;
+    int col_next = (base_y + 1) & wrap_mask;
+    float fx = x - base_x;
+    float fy = y - base_y;
+
+    float dot_tl = dot(gradient(base_x, col), vec2(fx, fy));
+    float dot_tr = dot(gradient(base_x + 1, col), vec2(fx - 1, fy));
+    float dot_bl = dot(gradient(base_x, col_next), vec2(fx, fy - 1));
+    float dot_br = dot(gradient(base_x + 1, col_next), vec2(fx - 1, fy - 1));
+
+    float ex = ease(fx);
+    float G = dot_tl + ex * (dot_tr - dot_tl);
+    float H = dot_bl + ex * (dot_br - dot_bl);
+    return G + ease(fy) * (H - G);
+}
+
+// See SimplexKernel::simplex(), a 3D sample blends the four corners of its tetrahedron
+float simplexNoise(vec3 p, int channel) {
+    const float F3 = 1.0 / 3.0;
+    const float G3 = 1.0 / 6.0;
+    ivec3 base = ivec3(floor(p + (p.x + p.y + p.z) * F3));
+    vec3 d0 = p - (vec3(base) - (base.x + base.y + base.z) * G3);
+
+    ivec3 o1, o2;
+    if (d0.x >= d0.y) {
+        if (d0.y >= d0.z)      { o1 = ivec3(1, 0, 0); o2 = ivec3(1, 1, 0); }
+        else if (d0.x >= d0.z) { o1 = ivec3(1, 0, 0); o2 = ivec3(1, 0, 1); }
+        else                   { o1 = ivec3(0, 0, 1); o2 = ivec3(1, 0, 1); }
+    } else {
+        if (d0.y < d0.z)       { o1 = ivec3(0, 0, 1); o2 = ivec3(0, 1, 1); }
+        else if (d0.x < d0.z)  { o1 = ivec3(0, 1, 0); o2 = ivec3(0, 1, 1); }
+        else                   { o1 = ivec3(0, 1, 0); o2 = ivec3(1, 1, 0); }
+    }
+
+    ivec3 offsets[4] = ivec3[4](ivec3(0), o1, o2, ivec3(1));
+    float n = 0;
+    for (int c = 0; c < 4; ++c) {
+        vec3 d = d0 - vec3(offsets[c]) + c * G3;
+        float falloff = 0.6 - dot(d, d);
+        if (falloff <= 0) continue;
+        falloff *= falloff;
+        ivec3 corner = base + offsets[c];
+        n += falloff * falloff * dot(gradient(corner.x, corner.y, corner.z, channel), d);
+    }
+    return 19.4 * n;
+}
+
+// Height of the 2:1 map at row coordinate x and column col
+float height(float x, int col) {
+    float y = float(col) / resolution;
+    float z = 0;
+    if (simplex) {
+        // On a cylinder of circumference octave_wrap around the row axis, see SimplexKernel::heightRow(),
+        // at the CPU's own coordinates rather than from this GPU's sin and cos
+        vec2 circle = texelFetch(wrap_columns, ivec2(col, 0), 0).xy;
+        for (int o = 0; o < octave_count; ++o) {
+            z += octave_amp[o] * simplexNoise(vec3(x, circle) * octave_freq[o], 0);
+        }
+        return z;
+    }
+    for (int o = 0; o < octave_count; ++o) {
+        int wrap_mask = int(octave_wrap * octave_freq[o]) - 1;
+        z += octave_amp[o] * perlin(x * octave_freq[o], y * octave_freq[o], wrap_mask);
+    }
+    return z;
+}
+
+float perlin(vec3 p, int channel) {
+    ivec3 base = ivec3(floor(p));
+    vec3 f = p - vec3(base);
+
+    float layers[2];
+    for (int k = 0; k < 2; ++k) {
+        float rows[2];
+        for (int j = 0; j < 2; ++j) {
+            float d0 = dot(gradient(base.x, base.y + j, base.z + k, channel), f - vec3(0, j, k));
+            float d1 = dot(gradient(base.x + 1, base.y + j, base.z + k, channel), f - vec3(1, j, k));
+            rows[j] = d0 + ease(f.x) * (d1 - d0);
+        }
+        layers[k] = rows[0] + ease(f.y) * (rows[1] - rows[0]);
+    }
+    return layers[0] + ease(f.z) * (layers[1] - layers[0]);
+}
+
+// Fractal sum of noise channel `channel` over the first `count` octaves, channel 0 being the height
+float height(vec3 p, int channel, int count) {
+    float z = 0;
+    for (int o = 0; o < min(count, octave_count); ++o) {
+        vec3 q = p * octave_freq[o];
+        z += octave_amp[o] * (simplex ? simplexNoise(q, channel) : perlin(q, channel));
+    }
+    return z;
+}
+
+// See craterCells() in CraterKernel: relief of one crater scale at p in cell units, from the
+// 2 x 2 x 2 cells nearest p. depth is per radius, threshold the lowest hash that holds a crater.
+float craterCells(vec3 p, int channel, float depth, float threshold) {
+    const float JITTER = 0.3;
+    const float RADIUS_MIN = 0.15;
+    const float RADIUS_MAX = 0.4;
+    const float RIM = 0.25;
+    const float RIM_WIDTH = 0.5;
+
+    ivec3 base = ivec3(floor(p - 0.5));
+    float sum = 0;
+    for (int i = 0; i <= 1; ++i) {
+        for (int j = 0; j <= 1; ++j) {
+            for (int k = 0; k <= 1; ++k) {
+                ivec3 cell = base + ivec3(i, j, k);
+                int h = (cell.x * 41 + cell.y * 43 + cell.z * 47 + channel * channel_offset) & mask;
+                float t = (texelFetch(gradients, ivec2((h + 1) & mask, 0), 0).x - threshold) / (1 - threshold);
+                if (t <= 0) continue;
+                float radius = RADIUS_MIN + (RADIUS_MAX - RADIUS_MIN) * t * t;
+                float d = depth * radius;
+
+                vec3 offset = p - (vec3(cell) + 0.5 + JITTER * texelFetch(gradients, ivec2(h, 0), 0).xyz);
+                float d2 = dot(offset, offset);
+                if (d2 < radius * radius) {
+                    sum += d * ((1 + RIM) * d2 / (radius * radius) - 1);
+                } else {
+                    float fall = max(1 - (sqrt(d2) - radius) / (RIM_WIDTH * radius), 0.0);
+                    sum += d * RIM * fall * fall;
+                }
+            }
+        }
+    }
+    return sum;
+}
+
+float craters(vec3 p) {
+    float threshold = 1 - 2 * crater_density;
+    float h = 0;
+    for (int s = 0; s < crater_count; ++s) {
+        h += craterCells(p * crater_freq[s], crater_channel + s, crater_depth[s] / crater_freq[s], threshold);
+    }
+    return h;
+}
+
+float height(vec3 p) {
+    return height(p, 0, octave_count) + craters(p);
+}
+
+// Direction through texel (row, col) of the current face, see getCubeDirection() on the CPU
+vec3 cubeDirection(int row, int col, int size) {
+    float sc = 2.0 * (col + 0.5) / size - 1.0;
+    float tc = 2.0 * (row + 0.5) / size - 1.0;
+    if (face == 0) return vec3(1, -tc, -sc);
+    if (face == 1) return vec3(-1, -tc, sc);
+    if (face == 2) return vec3(sc, 1, tc);
+    if (face == 3) return vec3(sc, -1, -tc);
+    if (face == 4) return vec3(sc, -tc, 1);
+    return vec3(-sc, -tc, -1);
+}
+
+vec3 colorFromHeight(float h) {
+    float last = textureSize(palette_ramp, 0).x - 1;
+    return texelFetch(palette_ramp, ivec2(int(clamp((h - ramp_min) * ramp_scale + 0.5, 0, last)), 0), 0).rgb;
+}
+
+// See BiomeTable::temperature(), moisture() and shadeRow()
+vec3 colorForBiome(vec3 dir) {
+    vec3 p = dir / PI;
+    float h = height(p);
+    float temperature = 0.85 + 2.5 * height(p, 1, biome_octaves) - 0.6 * dir.y * dir.y - 1.5 * max(h, 0.0);
+    float moisture = 0.5 + 3.0 * height(p, 2, biome_octaves);
+    int last = textureSize(biome_table, 0).x - 1;
+    vec2 climate = clamp(vec2(temperature, moisture), 0.0, 1.0) * last;
+    ivec2 base = min(ivec2(climate), ivec2(last - 1));
+    vec2 f = climate - vec2(base);
+    vec3 dry = mix(texelFetch(biome_table, base, 0).rgb, texelFetch(biome_table, base + ivec2(1, 0), 0).rgb, f.x);
+    vec3 wet = mix(texelFetch(biome_table, base + ivec2(0, 1), 0).rgb, texelFetch(biome_table, base + ivec2(1, 1), 0).rgb, f.x);
+    vec3 biome = mix(dry, wet, f.y);
+    return mix(colorFromHeight(h), biome, clamp((h - 0.01) / (0.02 - 0.01), 0.0, 1.0));
+}
+
+// atan(y, x) to within a few float ulps, as the CPU's. GLSL's may be far less precise, which the
+// sharp edges between bands would show.
+float preciseAtan(float y, float x) {
+    // Reduced to [0, tan(pi / 8)] as in Cephes' atanf
+    float a = min(abs(x), abs(y)) / max(max(abs(x), abs(y)), 1e-30);
+    float offset = 0;
+    if (a > 0.41421356) {
+        offset = PI / 4;
+        a = (a - 1) / (a + 1);
+    }
+    float z = a * a;
+    float r = offset + (((8.05374449538e-2 * z - 1.38776856032e-1) * z + 1.99777106478e-1) * z
+                        - 3.33329491539e-1) * z * a + a;
+    if (abs(y) > abs(x)) r = PI / 2 - r;
+    if (x < 0) r = PI - r;
+    return y < 0 ? -r : r;
+}
+
+vec3 colorForRing(int x, int y) {
+    vec2 column = texelFetch(band_columns, ivec2(y, 0), 0).xy;
+    vec2 row = texelFetch(band_rows, ivec2(x, 0), 0).xy;
+    float offset = column.x * row.x * band_scale + column.y * row.y;
+    return texelFetch(band_ramp, ivec2(int(x + offset) + band_pad, 0), 0).rgb;
+}
+
+void main() {
+    // Texel row x and column y of the map, as indexed by the CPU generator
+    int x = int(gl_FragCoord.y);
+    int y = int(gl_FragCoord.x);
+
+    vec3 color;
+    if (face >= 0) {
+        vec3 dir = normalize(cubeDirection(x, y, resolution / 2));
+        if (banded) {
+            // The 2:1 map at the same latitude and longitude, see TextureMap::getUVAt(), sampled
+            // bilinearly as in TerrainGenerator::generateColorTile()
+            float theta = preciseAtan(dir.z, dir.x);
+            float u = theta < 0 ? -theta / (2 * PI) : 1 - theta / (2 * PI);
+            float v = preciseAtan(dir.y, length(dir.xz)) / PI + 0.5;
+            int cols = resolution * 2;
+            float fx = clamp(v * resolution - 0.5, 0.0, resolution - 1.0);
+            float fy = u * cols - 0.5;
+            int x0 = min(int(fx), resolution - 2);
+            int y0 = int(floor(fy));
+            float tx = fx - x0;
+            float ty = fy - y0;
+            y0 = (y0 + cols) % cols;
+            int y1 = (y0 + 1) % cols;
+            vec3 top = mix(colorForRing(x0, y0), colorForRing(x0, y1), ty);
+            vec3 bottom = mix(colorForRing(x0 + 1, y0), colorForRing(x0 + 1, y1), ty);
+            color = mix(top, bottom, tx);
+        } else if (biomes) {
+            color = colorForBiome(dir);
+        } else {
+            color = colorFromHeight(height(dir / PI));
+        }
+    } else if (banded) {
+        color = colorForRing(x, y);
+    } else if (sphere) {
+        // The texel's direction on the sphere, see TerrainGenerator::generateNormalRows()
+        float latitude = ((x + 0.5) / resolution - 0.5) * PI;
+        float theta = -2 * PI * (y + 0.5) / (2 * resolution);
+        vec3 dir = vec3(cos(latitude) * cos(theta), sin(latitude), cos(latitude) * sin(theta));
+        color = biomes ? colorForBiome(dir) : colorFromHeight(height(dir / PI));
+    } else {
+        // Periodic along the columns, so the map closes seamlessly at the date line
+        color = colorFromHeight(height(float(x) / resolution, y));
+    }
+    frag_color = vec4(clamp(color, 0.0, 1.0), 1);
+}
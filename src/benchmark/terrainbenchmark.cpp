@@ -0,0 +1,668 @@
+// Throughput benchmark of TerrainGenerator, independent of Qt and GL.
+//
+// Usage: terrain_benchmark [--quick] [--out results.json]
+// Build it with -DCMAKE_BUILD_TYPE=Release, timings of an unoptimized build say little. Exits with
+// 1 if a specialized noise kernel disagrees with the generic path it replaces.
+//
+// Every case is repeated until it has run for at least MIN_SECONDS and reports texels per
+// second and ns per texel over all repetitions. Results are written as JSON (to stdout
+// unless --out is given) so that runs on different commits or machines can be diffed.
+
+#include "utils/blockcompressor.h"
+#include "utils/terraingenerator.h"
+#include "utils/terrainpipeline.h"
+#include "utils/parallel.h"
+#include "utils/workstealingpool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+// Rows of a color map per parallel work item
+static const int ROW_BLOCK = 16;
+
+static double MIN_SECONDS = 0.25;
+
+struct Result {
+    std::string benchmark;
+    std::string variant;    // planet type or palette, empty for the samplers
+    std::string layout;     // "equirect" or "cube", empty for the samplers
+    int resolution;
+    int octaves;            // noise octaves summed per texel, 0 if not applicable
+    int threads;
+    long long texels;       // per repetition
+    int repetitions;
+    double seconds;         // over all repetitions
+};
+
+// Repeats fn until MIN_SECONDS have passed; fn returns the number of texels it produced
+template <typename Fn>
+static Result measure(Fn &&fn) {
+    using clock = std::chrono::steady_clock;
+
+    Result result {};
+    auto start = clock::now();
+    double elapsed = 0;
+    do {
+        result.texels = fn();
+        result.repetitions += 1;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while (elapsed < MIN_SECONDS);
+
+    result.seconds = elapsed;
+    return result;
+}
+
+// Color map of the job on `threads` threads, split into row blocks
+static std::vector<std::uint8_t> generateColors(const TerrainGenerator &terrain, const TerrainJob &job, int threads) {
+    int rows = job.height();
+    std::vector<std::uint8_t> texels(job.width() * rows * 4);
+    parallelFor((rows + ROW_BLOCK - 1) / ROW_BLOCK, [&](int block) {
+        int row_begin = block * ROW_BLOCK;
+        terrain.generateColorRows(job, row_begin, std::min(row_begin + ROW_BLOCK, rows), texels.data());
+    }, threads);
+    return texels;
+}
+
+// Normal map of the job on `threads` threads, split into row blocks
+static std::vector<std::uint8_t> generateNormals(const TerrainGenerator &terrain, const TerrainJob &job, int threads) {
+    int rows = job.resolution;
+    std::vector<std::uint8_t> texels(std::size_t(rows) * 2 * rows * 2);
+    parallelFor((rows + ROW_BLOCK - 1) / ROW_BLOCK, [&](int block) {
+        int row_begin = block * ROW_BLOCK;
+        terrain.generateNormalRows(job, row_begin, std::min(row_begin + ROW_BLOCK, rows), texels.data());
+    }, threads);
+    return texels;
+}
+
+// Color map of the job as tiles on a work-stealing pool, the way TextureStreamer schedules them
+static std::vector<std::uint8_t> generateColorTiles(const TerrainGenerator &terrain, const TerrainJob &job,
+                                                    WorkStealingPool &pool) {
+    std::vector<std::uint8_t> texels(job.width() * job.height() * 4);
+    std::unique_ptr<BandSynthesizer> bands;
+    if (job.banded) bands = std::make_unique<BandSynthesizer>(terrain.createBands(job));
+
+    std::size_t stride = job.width() * 4;
+    for (auto &tile: terrain.createTiles(job)) {
+        pool.submit([&, tile]() {
+            auto out = texels.data() + tile.row * stride + tile.col * 4;
+            terrain.generateColorTile(job, bands.get(), tile, out, stride);
+        });
+    }
+    pool.wait();
+    return texels;
+}
+
+static std::string toJson(const std::vector<Result> &results, const std::vector<int> &resolutions,
+                          const std::vector<int> &thread_counts) {
+    auto list = [](const std::vector<int> &values) {
+        std::ostringstream out;
+        for (size_t i = 0; i < values.size(); ++i) out << (i ? ", " : "") << values[i];
+        return out.str();
+    };
+
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"generator_version\": " << TerrainGenerator::VERSION << ",\n";
+    out << "  \"isa\": \"" << PerlinKernel::isa() << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"min_seconds\": " << MIN_SECONDS << ",\n";
+    out << "  \"resolutions\": [" << list(resolutions) << "],\n";
+    out << "  \"thread_counts\": [" << list(thread_counts) << "],\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        double texels = double(r.texels) * r.repetitions;
+        out << "    {\"benchmark\": \"" << r.benchmark << "\"";
+        if (!r.variant.empty()) out << ", \"variant\": \"" << r.variant << "\"";
+        if (!r.layout.empty()) out << ", \"layout\": \"" << r.layout << "\"";
+        if (r.resolution > 0) out << ", \"resolution\": " << r.resolution;
+        if (r.octaves > 0) out << ", \"octaves\": " << r.octaves;
+        out << ", \"threads\": " << r.threads
+            << ", \"texels\": " << r.texels
+            << ", \"repetitions\": " << r.repetitions
+            << ", \"seconds\": " << r.seconds
+            << ", \"texels_per_second\": " << texels / r.seconds
+            << ", \"ns_per_texel\": " << r.seconds * 1e9 / texels
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+    return out.str();
+}
+
+int main(int argc, char *argv[]) {
+    bool quick = false;
+    std::string out_path;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--quick] [--out results.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    TerrainGenerator terrain;
+    std::vector<int> resolutions = quick ? std::vector<int> {128} : std::vector<int> {128, 256, 512};
+    int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (int t: {1, 2, 4, 8, hardware}) {
+        if (t <= hardware && std::find(thread_counts.begin(), thread_counts.end(), t) == thread_counts.end()) {
+            thread_counts.push_back(t);
+        }
+    }
+    if (quick) {
+        MIN_SECONDS = 0.05;
+        thread_counts = {1, hardware};
+        if (hardware == 1) thread_counts.pop_back();
+    }
+
+    std::vector<Result> results;
+    int mismatches = 0;     // specialized kernels whose results differ from the generic ones
+    auto record = [&](Result r, std::string benchmark, std::string variant, std::string layout, int resolution, int threads) {
+        r.benchmark = benchmark;
+        r.variant = variant;
+        r.layout = layout;
+        r.resolution = resolution;
+        r.threads = threads;
+        std::cerr << benchmark << " " << variant << " " << layout << " res " << resolution << " x" << threads << ": "
+                  << r.seconds * 1e9 / (double(r.texels) * r.repetitions) << " ns/texel" << std::endl;
+        results.push_back(r);
+    };
+
+    // Scalar samplers over a 512 x 512 grid of the unit square, Perlin and simplex noise side by
+    // side; the sum keeps the calls alive
+    auto noise = terrain.createJob(0, 1).noise;
+    volatile float sink = 0;
+    const int GRID = 512;
+    record(measure([&]() {
+        float sum = 0;
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) sum += terrain.computePerlin(noise, 16.f * x / GRID, 16.f * y / GRID);
+        }
+        sink = sum;
+        return (long long)GRID * GRID;
+    }), "computePerlin", "", "", 0, 1);
+    record(measure([&]() {
+        float sum = 0;
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) sum += terrain.computeSimplex(noise, 16.f * x / GRID, 16.f * y / GRID);
+        }
+        sink = sum;
+        return (long long)GRID * GRID;
+    }), "computeSimplex", "", "", 0, 1);
+    record(measure([&]() {
+        float sum = 0;
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) sum += terrain.getHeight(noise, 1.f * x / GRID, 1.f * y / GRID);
+        }
+        sink = sum;
+        return (long long)GRID * GRID;
+    }), "getHeight", "", "", 0, 1);
+
+    // 3D samples over a 512 x 512 slice of the unit cube's diagonal plane, as cube maps take them
+    record(measure([&]() {
+        float sum = 0;
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) sum += PerlinKernel::perlin(noise, 16.f * x / GRID, 16.f * y / GRID, 8.f * (x + y) / GRID);
+        }
+        sink = sum;
+        return (long long)GRID * GRID;
+    }), "perlin3D", "", "", 0, 1);
+    record(measure([&]() {
+        float sum = 0;
+        for (int x = 0; x < GRID; ++x) {
+            for (int y = 0; y < GRID; ++y) sum += SimplexKernel::simplex(noise, 16.f * x / GRID, 16.f * y / GRID, 8.f * (x + y) / GRID);
+        }
+        sink = sum;
+        return (long long)GRID * GRID;
+    }), "simplex3D", "", "", 0, 1);
+
+    // Whole color maps for every planet type in every noise basis, and every palette. Banded maps
+    // don't sample the basis, they are only run with their own.
+    std::vector<std::pair<std::string, TerrainJob>> jobs;
+    const char *type_names[] = {"PLANET_SUN", "PLANET_MOON", "PLANET_ROCKY", "PLANET_GAS"};
+    for (int type = PLANET_SUN; type <= PLANET_GAS; ++type) {
+        auto job = terrain.createJob(PlanetType(type), 1);
+        for (auto basis: {NoiseBasis::PERLIN, NoiseBasis::SIMPLEX}) {
+            if (job.banded && basis != job.basis) continue;
+            job.basis = basis;
+            jobs.emplace_back(std::string(type_names[type]) + "/" + NoiseKernel::name(basis), job);
+        }
+    }
+    for (int palette = 0; palette < 10; ++palette) {
+        jobs.emplace_back("palette" + std::to_string(palette), terrain.createJob(palette, 1));
+    }
+
+    for (auto &[variant, base_job]: jobs) {
+        for (int cubemap = 0; cubemap < 2; ++cubemap) {
+            for (int resolution: resolutions) {
+                auto job = base_job;
+                job.resolution = resolution;
+                job.cubemap = cubemap;
+                for (int threads: thread_counts) {
+                    record(measure([&]() {
+                        sink = generateColors(terrain, job, threads)[0];
+                        return (long long)job.width() * job.height();
+                    }), "generateTerrainColors", variant, cubemap ? "cube" : "equirect", resolution, threads);
+
+                    WorkStealingPool pool(threads);
+                    record(measure([&]() {
+                        sink = generateColorTiles(terrain, job, pool)[0];
+                        return (long long)job.width() * job.height();
+                    }), "generateColorTiles", variant, cubemap ? "cube" : "equirect", resolution, threads);
+                }
+            }
+        }
+    }
+
+    // Height grids of every resolution tier, with the octaves chosen from the texel footprint
+    // against the four fixed octaves of getHeight(), and in simplex noise
+    for (int resolution = TerrainGenerator::MIN_RESOLUTION; resolution <= terrain.getResolution(); resolution *= 2) {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1, resolution);
+        std::vector<float> row(resolution + 2);
+        std::tuple<const char *, Octaves, NoiseBasis> variants[] = {
+            {"footprint", job.octaves(), NoiseBasis::PERLIN},
+            {"fixed", Octaves::fixed(), NoiseBasis::PERLIN},
+            {"footprint/simplex", job.octaves(), NoiseBasis::SIMPLEX},
+        };
+        for (auto &[variant, octaves, basis]: variants) {
+            auto r = measure([&]() {
+                for (int x = 0; x < resolution; ++x) {
+                    NoiseKernel::heightRow(basis, job.noise, octaves, 1.f * x / resolution, -1, 1.f / resolution,
+                                           resolution + 2, row.data());
+                }
+                sink = row[0];
+                return (long long)resolution * (resolution + 2);
+            });
+            r.octaves = octaves.count;
+            record(r, "heightRows", variant, "equirect", resolution, 1);
+        }
+    }
+
+    // The SIMD row and point kernels against the scalar ones they replace, which they must match
+    // exactly: fixed and footprint octaves, wrapped and unwrapped rows, and counts that end in
+    // every length of partial vector
+    {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1);
+        std::vector<std::pair<std::string, Octaves>> octave_sets = {{"fixed", Octaves::fixed()}};
+        for (int resolution: {32, terrain.getResolution(), 8192}) {
+            octave_sets.emplace_back("res" + std::to_string(resolution), Octaves::forSpacing(1.f / resolution));
+        }
+        const int counts[] = {1, 3, 7, 8, 9, 15, 17, 1027};
+        const int MAX_COUNT = 1027;
+        std::vector<float> expected(MAX_COUNT), actual(MAX_COUNT);
+        for (auto [name, octaves]: octave_sets) {
+            for (int wrap: {0, 2}) {
+                octaves.wrap = wrap;
+                int differing = 0;
+                for (int count: counts) {
+                    for (int col0: {-1, 0, 5}) {
+                        for (float x: {0.f, 0.37f, 1.71f}) {
+                            float dz = 1.f / 512;
+                            PerlinKernel::heightRowScalar(job.noise, octaves, x, col0, dz, count, expected.data());
+                            PerlinKernel::heightRow(job.noise, octaves, x, col0, dz, count, actual.data());
+                            differing += std::memcmp(actual.data(), expected.data(), count * sizeof(float)) != 0;
+                        }
+                    }
+                }
+                if (differing > 0) {
+                    std::cerr << "heightRow " << PerlinKernel::isa() << " " << name << (wrap ? " wrapped" : "")
+                              << ": " << differing << " rows differ from heightRowScalar" << std::endl;
+                    mismatches += 1;
+                }
+            }
+        }
+
+        // Points spread over the noise sphere, in the order of no lattice
+        std::vector<float> x(MAX_COUNT), y(MAX_COUNT), z(MAX_COUNT), grad[3], expected_grad[3];
+        for (int c = 0; c < 3; ++c) {
+            grad[c].resize(MAX_COUNT);
+            expected_grad[c].resize(MAX_COUNT);
+        }
+        for (int i = 0; i < MAX_COUNT; ++i) {
+            auto p = glm::normalize(glm::vec3(std::sin(i * 1.3f), std::cos(i * 2.9f), std::sin(i * 0.7f + 1)));
+            x[i] = p.x * 0.3183f;
+            y[i] = p.y * 0.3183f;
+            z[i] = p.z * 0.3183f;
+        }
+        for (auto &[name, octaves]: octave_sets) {
+            int differing = 0;
+            for (int count: counts) {
+                SimplexKernel::heightPoints(job.noise, octaves, x.data(), y.data(), z.data(), count, actual.data());
+                for (int i = 0; i < count; ++i) expected[i] = SimplexKernel::height(job.noise, octaves, x[i], y[i], z[i]);
+                differing += std::memcmp(actual.data(), expected.data(), count * sizeof(float)) != 0;
+
+                SimplexKernel::heightPoints(job.noise, octaves, x.data(), y.data(), z.data(), count, actual.data(),
+                                            grad[0].data(), grad[1].data(), grad[2].data());
+                for (int i = 0; i < count; ++i) {
+                    float g[3];
+                    expected[i] = SimplexKernel::height(job.noise, octaves, x[i], y[i], z[i], g);
+                    for (int c = 0; c < 3; ++c) expected_grad[c][i] = g[c];
+                }
+                differing += std::memcmp(actual.data(), expected.data(), count * sizeof(float)) != 0;
+                for (int c = 0; c < 3; ++c) {
+                    differing += std::memcmp(grad[c].data(), expected_grad[c].data(), count * sizeof(float)) != 0;
+                }
+            }
+            if (differing > 0) {
+                std::cerr << "heightPoints simplex " << name << ": " << differing
+                          << " batches differ from SimplexKernel::height" << std::endl;
+                mismatches += 1;
+            }
+        }
+
+        // Crater layers of a moon from one scale to all of them, added onto zero so that the sums
+        // are the craters alone
+        auto moon = terrain.createJob(PlanetType::PLANET_MOON, 1);
+        for (int resolution: {64, 128, terrain.getResolution(), 8192}) {
+            moon.resolution = resolution;
+            auto craters = moon.craters();
+            int differing = 0;
+            for (int count: counts) {
+                std::fill(actual.begin(), actual.begin() + count, 0.f);
+                CraterKernel::addPoints(moon.noise, craters, x.data(), y.data(), z.data(), count, actual.data());
+                for (int i = 0; i < count; ++i) expected[i] = CraterKernel::crater(moon.noise, craters, x[i], y[i], z[i]);
+                differing += std::memcmp(actual.data(), expected.data(), count * sizeof(float)) != 0;
+
+                std::fill(actual.begin(), actual.begin() + count, 0.f);
+                for (int c = 0; c < 3; ++c) std::fill(grad[c].begin(), grad[c].begin() + count, 0.f);
+                CraterKernel::addPoints(moon.noise, craters, x.data(), y.data(), z.data(), count, actual.data(),
+                                        grad[0].data(), grad[1].data(), grad[2].data());
+                for (int i = 0; i < count; ++i) {
+                    float g[3];
+                    expected[i] = CraterKernel::crater(moon.noise, craters, x[i], y[i], z[i], g);
+                    for (int c = 0; c < 3; ++c) expected_grad[c][i] = g[c];
+                }
+                differing += std::memcmp(actual.data(), expected.data(), count * sizeof(float)) != 0;
+                for (int c = 0; c < 3; ++c) {
+                    differing += std::memcmp(grad[c].data(), expected_grad[c].data(), count * sizeof(float)) != 0;
+                }
+            }
+            if (differing > 0) {
+                std::cerr << "addPoints craters res" << resolution << ": " << differing
+                          << " batches differ from CraterKernel::crater" << std::endl;
+                mismatches += 1;
+            }
+        }
+
+        // One to three channels, the extra ones over the biome octaves, through the AVX2 channel
+        // kernels and the unrolled ones TerrainPipeline selects, against the scalar loops. Perlin's
+        // channelPoints() is the scalar loop, so it is only the reference.
+        std::vector<float> channel_actual[3], channel_expected[3];
+        float *actual_out[3], *expected_out[3];
+        for (int c = 0; c < 3; ++c) {
+            channel_actual[c].resize(MAX_COUNT);
+            channel_expected[c].resize(MAX_COUNT);
+            actual_out[c] = channel_actual[c].data();
+            expected_out[c] = channel_expected[c].data();
+        }
+        auto differs = [&](int channels, int count) {
+            int differing = 0;
+            for (int c = 0; c < channels; ++c) {
+                differing += std::memcmp(actual_out[c], expected_out[c], count * sizeof(float)) != 0;
+            }
+            return differing;
+        };
+        const int channel_octaves = TerrainGenerator::BIOME_OCTAVES;
+        for (auto &[name, octaves]: octave_sets) {
+            for (int channels = 1; channels <= 3; ++channels) {
+                int simplex_differing = 0, simplex_unrolled_differing = 0, perlin_unrolled_differing = 0;
+                for (int count: counts) {
+                    SimplexKernel::channelPointsScalar(job.noise, octaves, channels, channel_octaves,
+                                                       x.data(), y.data(), z.data(), count, expected_out);
+                    SimplexKernel::channelPoints(job.noise, octaves, channels, channel_octaves,
+                                                 x.data(), y.data(), z.data(), count, actual_out);
+                    simplex_differing += differs(channels, count);
+
+                    NoisePointsKernel simplex_kernel = nullptr;
+                    if (channels == 1) simplex_kernel = SimplexKernel::unrolledPoints<1, 0>(octaves.count);
+                    if (channels == 3) simplex_kernel = SimplexKernel::unrolledPoints<3, channel_octaves>(octaves.count);
+                    if (simplex_kernel != nullptr) {
+                        simplex_kernel(job.noise, octaves, x.data(), y.data(), z.data(), count, actual_out);
+                        simplex_unrolled_differing += differs(channels, count);
+                    }
+
+                    if (channels == 1) {
+                        PerlinKernel::channelPoints(job.noise, octaves, 1, 0, x.data(), y.data(), z.data(),
+                                                    count, expected_out);
+                        PerlinKernel::unrolledPoints<1, 0>(octaves.count)(job.noise, octaves, x.data(), y.data(),
+                                                                          z.data(), count, actual_out);
+                        perlin_unrolled_differing += differs(1, count);
+                    }
+                }
+                std::pair<const char *, int> results[] = {
+                    {"channelPoints simplex", simplex_differing},
+                    {"unrolledPoints simplex", simplex_unrolled_differing},
+                    {"unrolledPoints perlin", perlin_unrolled_differing},
+                };
+                for (auto [kernel, differing]: results) {
+                    if (differing == 0) continue;
+                    std::cerr << kernel << " " << name << ", " << channels << " channels: " << differing
+                              << " batches differ from the scalar loop" << std::endl;
+                    mismatches += 1;
+                }
+            }
+        }
+    }
+
+    // Height plus biome channels in one pass, one channel more at a time, so that the difference
+    // between consecutive variants is the marginal cost of a channel; against separate passes
+    // over the same octaves, the height's and then each channel's
+    {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1);
+        auto octaves = job.octaves();
+        auto channel_octaves = octaves;
+        channel_octaves.count = std::min(octaves.count, TerrainGenerator::BIOME_OCTAVES);
+        const int COUNT = GRID * GRID / 2;
+        const float PI = 3.14159265f;
+        std::vector<float> x(COUNT), y(COUNT), z(COUNT), channels[3];
+        for (int i = 0; i < COUNT; ++i) {
+            float latitude = ((i / GRID + 0.5f) / (GRID / 2) - 0.5f) * PI;
+            float theta = 2 * PI * (i % GRID + 0.5f) / GRID;
+            auto p = glm::vec3(std::cos(latitude) * std::cos(theta), std::sin(latitude),
+                               std::cos(latitude) * std::sin(theta)) / PI;
+            x[i] = p.x;
+            y[i] = p.y;
+            z[i] = p.z;
+        }
+        for (auto &c: channels) c.resize(COUNT);
+        float *out[3] = {channels[0].data(), channels[1].data(), channels[2].data()};
+        for (auto basis: {NoiseBasis::PERLIN, NoiseBasis::SIMPLEX}) {
+            std::string name = NoiseKernel::name(basis);
+            for (int count = 1; count <= 3; ++count) {
+                auto r = measure([&]() {
+                    NoiseKernel::channelPoints(basis, job.noise, octaves, count, TerrainGenerator::BIOME_OCTAVES,
+                                               x.data(), y.data(), z.data(), COUNT, out);
+                    sink = channels[0][0];
+                    return (long long)COUNT;
+                });
+                r.octaves = octaves.count;
+                record(r, "channelPoints", name + "/channels" + std::to_string(count), "", 0, 1);
+            }
+            auto r = measure([&]() {
+                NoiseKernel::heightPoints(basis, job.noise, octaves, x.data(), y.data(), z.data(), COUNT, out[0]);
+                for (int c = 1; c < 3; ++c) {
+                    NoiseKernel::heightPoints(basis, job.noise, channel_octaves, x.data(), y.data(), z.data(),
+                                              COUNT, out[c]);
+                }
+                sink = channels[0][0];
+                return (long long)COUNT;
+            });
+            r.octaves = octaves.count;
+            record(r, "channelPoints", name + "/separate3", "", 0, 1);
+        }
+
+        // The crater layer of a moon over the same points, all its scales
+        auto craters = terrain.createJob(PlanetType::PLANET_MOON, 1).craters();
+        record(measure([&]() {
+            std::fill(channels[0].begin(), channels[0].end(), 0.f);
+            CraterKernel::addPoints(job.noise, craters, x.data(), y.data(), z.data(), COUNT, out[0]);
+            sink = channels[0][0];
+            return (long long)COUNT;
+        }), "craterPoints", "", "", 0, 1);
+
+        // The noise of every planet type with a noise kernel, through NoiseKernel's dispatch and
+        // octave loop against its TerrainPipeline kernel, at the octaves of a small, a default and
+        // a virtual texture's finest map. The two must agree exactly.
+        std::vector<float> expected[3];
+        for (auto &c: expected) c.resize(COUNT);
+        float *expected_out[3] = {expected[0].data(), expected[1].data(), expected[2].data()};
+        for (int type: {PLANET_SUN, PLANET_MOON, PLANET_ROCKY}) {
+            for (int resolution: {128, terrain.getResolution(), 8192}) {
+                auto planet_job = terrain.createJob(PlanetType(type), 1, resolution);
+                auto planet_octaves = planet_job.octaves();
+                int count = planet_job.biomes != nullptr ? 3 : 1;
+                auto generic = [&](float *const *channels_out) {
+                    if (count == 1) {
+                        NoiseKernel::heightPoints(planet_job.basis, planet_job.noise, planet_octaves,
+                                                  x.data(), y.data(), z.data(), COUNT, channels_out[0]);
+                        return;
+                    }
+                    NoiseKernel::channelPoints(planet_job.basis, planet_job.noise, planet_octaves, count,
+                                               TerrainGenerator::BIOME_OCTAVES, x.data(), y.data(), z.data(),
+                                               COUNT, channels_out);
+                };
+                auto kernel = TerrainPipeline::select(planet_job, planet_octaves);
+
+                std::string variant = type_names[type];
+                auto r = measure([&]() {
+                    generic(out);
+                    sink = channels[0][0];
+                    return (long long)COUNT;
+                });
+                r.octaves = planet_octaves.count;
+                record(r, "pipelinePoints", variant + "/generic", "", resolution, 1);
+
+                r = measure([&]() {
+                    kernel(planet_job.noise, planet_octaves, x.data(), y.data(), z.data(), COUNT, out);
+                    sink = channels[0][0];
+                    return (long long)COUNT;
+                });
+                r.octaves = planet_octaves.count;
+                record(r, "pipelinePoints", variant + "/unrolled", "", resolution, 1);
+
+                generic(expected_out);
+                for (int c = 0; c < count; ++c) {
+                    if (std::memcmp(channels[c].data(), expected[c].data(), COUNT * sizeof(float)) != 0) {
+                        std::cerr << "pipelinePoints " << variant << " at " << resolution
+                                  << ": channel " << c << " differs from NoiseKernel" << std::endl;
+                        mismatches += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int resolution: resolutions) {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1, resolution);
+        for (int threads: thread_counts) {
+            record(measure([&]() {
+                sink = generateNormals(terrain, job, threads)[0];
+                return (long long)job.width() * job.height();
+            }), "generateTerrainNormals", "PLANET_ROCKY", "equirect", resolution, threads);
+        }
+    }
+
+    // Block compression of generated maps as the renderer uploads them: BC1 of every planet type's
+    // cube map and BC5 of a rocky normal map, with the memory saved and the error of the round trip
+    auto rms = [](const std::vector<std::uint8_t> &a, const std::vector<std::uint8_t> &b, int channels, int step) {
+        double sum = 0;
+        for (std::size_t i = 0; i < a.size(); i += step) {
+            for (int c = 0; c < channels; ++c) sum += double(a[i + c] - b[i + c]) * (a[i + c] - b[i + c]);
+        }
+        return std::sqrt(sum / (a.size() / step * channels));
+    };
+    for (int type = PLANET_SUN; type <= PLANET_GAS; ++type) {
+        for (int resolution: resolutions) {
+            auto job = terrain.createJob(PlanetType(type), 1, resolution);
+            job.cubemap = true;
+            auto texels = generateColors(terrain, job, hardware);
+            std::vector<std::uint8_t> blocks(BlockCompressor::bc1Size(job.width(), job.height()));
+            for (int threads: thread_counts) {
+                record(measure([&]() {
+                    BlockCompressor::encodeBC1(texels.data(), job.width(), job.height(), blocks.data(), threads);
+                    sink = blocks[0];
+                    return (long long)job.width() * job.height();
+                }), "encodeBC1", type_names[type], "cube", resolution, threads);
+            }
+            std::vector<std::uint8_t> decoded(texels.size());
+            BlockCompressor::decodeBC1(blocks.data(), job.width(), job.height(), decoded.data());
+            std::cerr << "encodeBC1 " << type_names[type] << " res " << resolution << ": " << texels.size()
+                      << " -> " << blocks.size() << " bytes, RMS error " << rms(texels, decoded, 3, 4) << std::endl;
+        }
+    }
+    for (int resolution: resolutions) {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1, resolution);
+        auto normals = terrain.generateTerrainNormals(job);
+        std::vector<std::uint8_t> blocks(BlockCompressor::bc5Size(job.width(), job.height()));
+        for (int threads: thread_counts) {
+            record(measure([&]() {
+                BlockCompressor::encodeBC5(normals.data(), job.width(), job.height(), blocks.data(), threads);
+                sink = blocks[0];
+                return (long long)job.width() * job.height();
+            }), "encodeBC5", "PLANET_ROCKY", "equirect", resolution, threads);
+        }
+        std::vector<std::uint8_t> decoded(normals.size());
+        BlockCompressor::decodeBC5(blocks.data(), job.width(), job.height(), decoded.data());
+        std::cerr << "encodeBC5 PLANET_ROCKY res " << resolution << ": " << normals.size()
+                  << " -> " << blocks.size() << " bytes, RMS error " << rms(normals, decoded, 2, 2) << std::endl;
+    }
+
+    // Virtual texture pages of a rocky planet, borders included, at the coarsest and finest levels
+    // of VirtualTexture: 128 x 128 texels on faces of 126 and 32 * 126 texels
+    for (int face_size: {126, 32 * 126}) {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1);
+        std::vector<std::uint8_t> page(128 * 128 * 4);
+        record(measure([&]() {
+            terrain.generateCubePage(job, face_size, 0, -1, -1, 128, page.data());
+            sink = page[0];
+            return 128LL * 128;
+        }), "generateCubePage", "PLANET_ROCKY", "cube", face_size, 1);
+    }
+
+    // Displaced surface chunks of PlanetTerrain, 33 x 33 vertices, for a whole face and for a
+    // chunk of the finest level, 4096 to a face side
+    for (int chunks: {1, 1 << 12}) {
+        auto job = terrain.createJob(PlanetType::PLANET_ROCKY, 1);
+        record(measure([&]() {
+            float size = 2.f / chunks;
+            auto vertices = terrain.generateTerrainDisplacement(job, 0, -1 + size * (chunks / 2), -1 + size * (chunks / 2), size, 32);
+            sink = vertices[0];
+            return 33LL * 33;
+        }), "generateTerrainDisplacement", "PLANET_ROCKY", "chunk", chunks, 1);
+    }
+
+    // A cloud keyframe, one row at a time as the cloud layer's worker generates it
+    for (int resolution: resolutions) {
+        auto job = terrain.createCloudJob(1, resolution);
+        std::vector<std::uint8_t> coverage(std::size_t(job.resolution) * 2 * job.resolution);
+        record(measure([&]() {
+            for (int row = 0; row < job.resolution; ++row) {
+                terrain.generateCloudRows(job, 0.5f, row, row + 1, coverage.data());
+            }
+            sink = coverage[0];
+            return (long long)coverage.size();
+        }), "generateCloudRows", "clouds", "equirect", resolution, 1);
+    }
+
+    auto json = toJson(results, resolutions, thread_counts);
+    if (out_path.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream file(out_path);
+        file << json;
+        if (!file) {
+            std::cerr << "Could not write " << out_path << std::endl;
+            return 1;
+        }
+    }
+    return mismatches > 0 ? 1 : 0;
+}
@@ -76,6 +76,16 @@ void Camera::rotateCamera(float dx, float dy) {
     updateView();
 }
 
+float Camera::getScreenDiameter(glm::vec3 center, float radius, int screen_height) const {
+    // The camera is inside the sphere, which then covers the whole screen
+    float distance = glm::length(center - m_pos);
+    if (distance <= radius) return screen_height;
+
+    // Tangent of the half angle the sphere subtends, relative to that of the view frustum
+    float half_angle = glm::asin(radius / distance);
+    return screen_height * glm::tan(half_angle) / glm::tan(m_heightAngle / 2);
+}
+
 void Camera::updateView() {
     // Compute the u, v, and w vectors based on look, up, and pos
     glm::vec3 w = glm::normalize(-m_look);
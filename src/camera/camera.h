@@ -30,6 +30,12 @@ public:
     // Returns the current camera position
     glm::vec4 getPosition() const { return glm::vec4(m_pos, 1); };
 
+    // Returns the vertical field of view, in radians
+    float getHeightAngle() const { return m_heightAngle; };
+
+    // Returns the height in pixels that a sphere at center with the given radius covers on screen
+    float getScreenDiameter(glm::vec3 center, float radius, int screen_height) const;
+
     // Final Project
     void resetCameraOrbit();
 
@@ -0,0 +1,282 @@
+// Headless check of the GPU baker against the CPU generator, on an EGL context without a surface,
+// e.g. Mesa's llvmpipe, so that it runs without a display or a GPU.
+//
+// Usage: texture_check [--quick]
+// Run from the repository root, where the baking shader is loaded from. Every planet type in both
+// noise bases and every palette is baked with TextureBaker in both layouts and compared texel by
+// texel with TerrainGenerator::generateTerrainColors(). The cube maps of both are also checked for
+// seams between their faces. Exits with 1 if any channel is more than 1/255 off or a face edge
+// shows a seam, and with 2 if no GL 3.3 context can be created.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "renderer/texturebaker.h"
+#include "utils/terraingenerator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Largest difference per channel between the two, in 1/255 steps
+static const int TOLERANCE = 1;
+
+// A seam is a face edge whose texels differ from those across it by more than SEAM_RATIO times
+// the larger step into either face, plus one, on average per channel. Below SEAM_MIN_SIZE texels
+// per face the noise is at the texel spacing, and a step at an edge says nothing about a seam.
+static const float SEAM_RATIO = 1.5f;
+static const int SEAM_MIN_SIZE = 128;
+
+// Face, row and column of the texel a direction selects in a cube map of size x size faces, by
+// GL's cube map selection rules, independently of TerrainGenerator::getCubeDirection()
+static void selectTexel(glm::vec3 dir, int size, int &face, int &row, int &col) {
+    glm::vec3 a = glm::abs(dir);
+    float sc, tc, major;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = dir.x > 0 ? 0 : 1;
+        sc = dir.x > 0 ? -dir.z : dir.z;
+        tc = -dir.y;
+        major = a.x;
+    } else if (a.y >= a.z) {
+        face = dir.y > 0 ? 2 : 3;
+        sc = dir.x;
+        tc = dir.y > 0 ? dir.z : -dir.z;
+        major = a.y;
+    } else {
+        face = dir.z > 0 ? 4 : 5;
+        sc = dir.z > 0 ? dir.x : -dir.x;
+        tc = -dir.y;
+        major = a.z;
+    }
+    col = std::clamp(int((sc / major + 1) / 2 * size), 0, size - 1);
+    row = std::clamp(int((tc / major + 1) / 2 * size), 0, size - 1);
+}
+
+// The texel that the direction through (row, col) of a face, continued past its edges, selects
+static void selectTexel(int face, int row, int col, int size, int &other_face, int &other_row, int &other_col) {
+    glm::vec3 dir = TerrainGenerator::getCubeDirection(face, 2.f * (col + 0.5f) / size - 1.f,
+                                                       2.f * (row + 0.5f) / size - 1.f);
+    selectTexel(dir, size, other_face, other_row, other_col);
+}
+
+// Whether every texel's direction selects that texel again, i.e. the generator lays its faces out
+// as GL samples them. This holds for any content, even maps that look the same from every side.
+static bool checkCubeDirections(int size) {
+    for (int face = 0; face < 6; ++face) {
+        for (int row = 0; row < size; ++row) {
+            for (int col = 0; col < size; ++col) {
+                int other_face, other_row, other_col;
+                selectTexel(face, row, col, size, other_face, other_row, other_col);
+                if (other_face != face || other_row != row || other_col != col) {
+                    std::cerr << "Cube direction of face " << face << " texel (" << row << ", " << col
+                              << ") selects face " << other_face << " texel (" << other_row << ", "
+                              << other_col << ")" << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Checks every edge of every face of a cube map, stacked as in TerrainJob, against the texels its
+// directions continue into on the adjacent face; reports the edges with seams
+static int checkSeams(const std::vector<std::uint8_t> &texels, int size, const std::string &name) {
+    if (size < SEAM_MIN_SIZE) return 0;
+
+    auto texel = [&](int face, int row, int col) {
+        return &texels[((std::size_t(face) * size + row) * size + col) * 4];
+    };
+    auto difference = [](const std::uint8_t *a, const std::uint8_t *b) {
+        return std::abs(a[0] - b[0]) + std::abs(a[1] - b[1]) + std::abs(a[2] - b[2]);
+    };
+
+    // Edges as a step out of the face in (row, col): up, down, left, right
+    const int steps[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int seams = 0;
+    for (int face = 0; face < 6; ++face) {
+        for (auto &step: steps) {
+            double across = 0, inside = 0;
+            for (int i = 0; i < size; ++i) {
+                int row = step[0] < 0 ? 0 : step[0] > 0 ? size - 1 : i;
+                int col = step[1] < 0 ? 0 : step[1] > 0 ? size - 1 : i;
+
+                // The texels one and two steps past the edge, on the adjacent face
+                int face1, row1, col1, face2, row2, col2;
+                selectTexel(face, row + step[0], col + step[1], size, face1, row1, col1);
+                selectTexel(face, row + 2 * step[0], col + 2 * step[1], size, face2, row2, col2);
+
+                const std::uint8_t *edge = texel(face, row, col), *other = texel(face1, row1, col1);
+                across += difference(edge, other);
+                inside += std::max(difference(edge, texel(face, row - step[0], col - step[1])),
+                                   difference(other, texel(face2, row2, col2)));
+            }
+            across /= 3.0 * size;
+            inside /= 3.0 * size;
+            if (across > SEAM_RATIO * (inside + 1)) {
+                std::cerr << name << ": seam at face " << face << " edge (" << step[0] << ", " << step[1]
+                          << "), " << across << " steps across it against " << inside << " inside" << std::endl;
+                seams += 1;
+            }
+        }
+    }
+    return seams;
+}
+
+// Creates a core GL 3.3 context on the surfaceless platform and makes it current
+static bool createContext() {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay == nullptr) return false;
+    EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) return false;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT) return false;
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return false;
+
+    glewExperimental = GL_TRUE;
+    return glewInit() == GLEW_OK;
+}
+
+// A fullscreen quad with position and uv attributes, as TextureBaker draws it
+static GLuint createQuad() {
+    const GLfloat vertices[] = {
+        -1,  1, 0, 0, 1,
+        -1, -1, 0, 0, 0,
+         1, -1, 0, 1, 0,
+         1,  1, 0, 1, 1,
+        -1,  1, 0, 0, 1,
+         1, -1, 0, 1, 0,
+    };
+    GLuint vao, vbo;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), nullptr);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), reinterpret_cast<void *>(3 * sizeof(GLfloat)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return vao;
+}
+
+// Bakes the job's color map and reads it back, a cube map's faces stacked as in TerrainJob
+static std::vector<std::uint8_t> bake(TextureBaker &baker, const TerrainJob &job) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    baker.bake(job, texture);
+
+    std::vector<std::uint8_t> texels(std::size_t(job.width()) * job.height() * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (job.cubemap) {
+        std::size_t face_bytes = std::size_t(job.width()) * job.width() * 4;
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int face = 0; face < 6; ++face) {
+            glGetTexImage(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                          texels.data() + face * face_bytes);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glDeleteTextures(1, &texture);
+    return texels;
+}
+
+int main(int argc, char *argv[]) {
+    bool quick = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--quick]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!createContext()) {
+        std::cerr << "Could not create a GL 3.3 core context through EGL" << std::endl;
+        return 2;
+    }
+    std::cerr << "Baking on " << glGetString(GL_RENDERER) << std::endl;
+
+    TerrainGenerator terrain;
+    TextureBaker baker;
+    baker.initialize(createQuad());
+
+    // Every planet type in every noise basis, and every palette, as in terrain_benchmark
+    std::vector<std::pair<std::string, TerrainJob>> jobs;
+    const char *type_names[] = {"PLANET_SUN", "PLANET_MOON", "PLANET_ROCKY", "PLANET_GAS"};
+    for (int type = PLANET_SUN; type <= PLANET_GAS; ++type) {
+        auto job = terrain.createJob(PlanetType(type), 7 + type);
+        for (auto basis: {NoiseBasis::PERLIN, NoiseBasis::SIMPLEX}) {
+            if (job.banded && basis != job.basis) continue;
+            job.basis = basis;
+            jobs.emplace_back(std::string(type_names[type]) + "/" + NoiseKernel::name(basis), job);
+        }
+    }
+    for (int palette = 0; palette < 10; ++palette) {
+        jobs.emplace_back("palette" + std::to_string(palette), terrain.createJob(palette, 100 + palette));
+    }
+
+    std::vector<int> resolutions = quick ? std::vector<int> {64, 256} : std::vector<int> {64, 256, 512};
+    int failures = 0;
+    if (!checkCubeDirections(SEAM_MIN_SIZE)) failures += 1;
+    for (auto &[variant, base_job]: jobs) {
+        for (int cubemap = 0; cubemap < 2; ++cubemap) {
+            for (int resolution: resolutions) {
+                auto job = base_job;
+                job.resolution = resolution;
+                job.cubemap = cubemap;
+                auto baked = bake(baker, job);
+                auto expected = terrain.generateTerrainColors(job);
+
+                int worst = 0;
+                std::size_t off = 0;
+                for (std::size_t i = 0; i < expected.size(); ++i) {
+                    int difference = std::abs(int(baked[i]) - int(expected[i]));
+                    worst = std::max(worst, difference);
+                    off += difference > TOLERANCE;
+                }
+                std::string name = variant + (cubemap ? " cube" : " equirect") + " res " + std::to_string(resolution);
+                if (off > 0) {
+                    std::cerr << name << ": " << off << " channels off by more than " << TOLERANCE
+                              << ", up to " << worst << std::endl;
+                    failures += 1;
+                } else {
+                    std::cerr << name << ": ok, max difference " << worst << std::endl;
+                }
+                if (cubemap) {
+                    failures += checkSeams(expected, job.width(), name + " generated");
+                    failures += checkSeams(baked, job.width(), name + " baked");
+                }
+            }
+        }
+    }
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        std::cerr << "GL error " << error << std::endl;
+        failures += 1;
+    }
+    std::cerr << (failures > 0 ? std::to_string(failures) + " checks failed" : "All checks passed") << std::endl;
+    return failures > 0 ? 1 : 0;
+}
@@ -188,6 +188,22 @@ void MainWindow::initialize() {
     normalMapping->setText(QStringLiteral("Enable Normal Mapping"));
     normalMapping->setChecked(false);
 
+    gpuTextures = new QCheckBox();
+    gpuTextures->setText(QStringLiteral("Bake Textures on GPU"));
+    gpuTextures->setChecked(false);
+
+    clouds = new QCheckBox();
+    clouds->setText(QStringLiteral("Animate Clouds"));
+    clouds->setChecked(false);
+
+    displacedTerrain = new QCheckBox();
+    displacedTerrain->setText(QStringLiteral("Displace Terrain"));
+    displacedTerrain->setChecked(false);
+
+    compressTextures = new QCheckBox();
+    compressTextures->setText(QStringLiteral("Compress Textures"));
+    compressTextures->setChecked(false);
+
     QGroupBox *g1Layout = new QGroupBox();
     QHBoxLayout *g1 = new QHBoxLayout();
 
@@ -215,6 +231,10 @@ void MainWindow::initialize() {
     vLayout->addWidget(showOrbits);
     vLayout->addWidget(proceduralTexture);
     vLayout->addWidget(normalMapping);
+    vLayout->addWidget(gpuTextures);
+    vLayout->addWidget(clouds);
+    vLayout->addWidget(displacedTerrain);
+    vLayout->addWidget(compressTextures);
     vLayout->addWidget(GPS_params_label);
     vLayout->addWidget(num_planet_label);
     vLayout->addWidget(g1Layout);
@@ -307,6 +327,10 @@ void MainWindow::connectGPS() {
     connect(orbitCamera, &QCheckBox::clicked, this, &MainWindow::onOrbitCamera);
     connect(proceduralTexture, &QCheckBox::clicked, this, &MainWindow::onProceduralTexture);
     connect(normalMapping, &QCheckBox::clicked, this, &MainWindow::onNormalMapping);
+    connect(gpuTextures, &QCheckBox::clicked, this, &MainWindow::onGpuTextures);
+    connect(clouds, &QCheckBox::clicked, this, &MainWindow::onClouds);
+    connect(displacedTerrain, &QCheckBox::clicked, this, &MainWindow::onDisplacedTerrain);
+    connect(compressTextures, &QCheckBox::clicked, this, &MainWindow::onCompressTextures);
 }
 
 void MainWindow::onValChangeP1(int newValue) {
@@ -407,6 +431,22 @@ void MainWindow::onNormalMapping() {
     settings.normalMapping = !settings.normalMapping;
 }
 
+void MainWindow::onGpuTextures() {
+    settings.gpuTextures = !settings.gpuTextures;
+}
+
+void MainWindow::onClouds() {
+    settings.clouds = !settings.clouds;
+}
+
+void MainWindow::onDisplacedTerrain() {
+    settings.displacedTerrain = !settings.displacedTerrain;
+}
+
+void MainWindow::onCompressTextures() {
+    settings.compressTextures = !settings.compressTextures;
+}
+
 void MainWindow::onValChangeG1(int newValue) {
     numPlanetSlider->setValue(newValue);
     numPlanetBox->setValue(newValue);
@@ -51,6 +51,10 @@ private:
     QCheckBox *showOrbits;
     QCheckBox *proceduralTexture;
     QCheckBox *normalMapping;
+    QCheckBox *gpuTextures;
+    QCheckBox *clouds;
+    QCheckBox *displacedTerrain;
+    QCheckBox *compressTextures;
     QSlider *numPlanetSlider;
     QSpinBox *numPlanetBox;
 
@@ -78,5 +82,9 @@ private slots:
     void onShowOrbits();
     void onProceduralTexture();
     void onNormalMapping();
+    void onGpuTextures();
+    void onClouds();
+    void onDisplacedTerrain();
+    void onCompressTextures();
     void onValChangeG1(int newValue);
 };
@@ -127,12 +127,14 @@ void Realtime::initializeGL() {
 
     m_planet_shader = ShaderLoader::createShaderProgram(
                 "resources/shaders/phong.vert",
-                "resources/shaders/planet.frag"
+                "resources/shaders/planet.frag",
+                "resources/shaders/planetsurface.glsl"
     );
 
     m_normal_map_shader = ShaderLoader::createShaderProgram(
             "resources/shaders/normalmap.vert",
-            "resources/shaders/normalmap.frag"
+            "resources/shaders/normalmap.frag",
+            "resources/shaders/planetsurface.glsl"
     );
 
     configurePixelShaders();
@@ -306,6 +308,7 @@ void Realtime::timerEvent(QTimerEvent *event) {
     // Update planet positions
     if (!settings.pause) {
         m_renderer.updatePlanets(deltaTime);
+        m_renderer.updateClouds(deltaTime);
     }
 
     update(); // asks for a PaintGL() call to occur
@@ -0,0 +1,139 @@
+#include "renderer/cloudlayer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Rows per task when the first keyframe is generated up front
+static const int START_ROWS = 16;
+
+CloudLayer::~CloudLayer() {
+    // A running slice finishes into texels nobody will upload
+    m_pool.reset();
+}
+
+void CloudLayer::start(const TerrainGenerator *terrain, unsigned int seed, int resolution) {
+    stop();
+
+    m_terrain = terrain;
+    m_job = terrain->createCloudJob(seed, resolution);
+    int width = m_job.resolution * 2;
+    int height = m_job.resolution;
+    m_texels.assign(std::size_t(width) * height, 0);
+
+    // The first keyframe is needed before anything can be shown, so it is generated on every core.
+    // Its cost tells how long the worker will take over each of the following ones.
+    auto begin = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool;
+        for (int row = 0; row < height; row += START_ROWS) {
+            pool.submit([this, row, height]() {
+                m_terrain->generateCloudRows(m_job, 0, row, std::min(row + START_ROWS, height), m_texels.data());
+            });
+        }
+        pool.wait();
+        auto elapsed = std::chrono::steady_clock::now() - begin;
+        m_keyframe_us = std::chrono::duration<float, std::micro>(elapsed).count() * pool.getThreadCount();
+    }
+
+    // Coverage wraps around in longitude only
+    glGenTextures(3, m_textures);
+    glActiveTexture(GL_TEXTURE0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < 3; ++i) {
+        glBindTexture(GL_TEXTURE_2D, m_textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0,
+                     GL_RED, GL_UNSIGNED_BYTE, i < 2 ? m_texels.data() : nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    m_time = 0;
+    m_next_time = -1;
+    m_drift = 0;
+    m_uploaded = 0;
+    m_generated = 0;
+    m_busy = false;
+    m_pool = std::make_unique<WorkStealingPool>(1);
+}
+
+void CloudLayer::stop() {
+    // Waits for a running slice, a queued one is dropped
+    m_pool.reset();
+    m_busy = false;
+
+    if (isActive()) {
+        glDeleteTextures(3, m_textures);
+        std::fill(m_textures, m_textures + 3, 0);
+    }
+    m_texels = {};
+}
+
+void CloudLayer::submitSlice() {
+    m_busy = true;
+    m_pool->submit([this]() {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(BUDGET_US);
+        int row = m_generated.load(std::memory_order_relaxed);
+        while (row < m_job.resolution && std::chrono::steady_clock::now() < deadline) {
+            m_terrain->generateCloudRows(m_job, m_next_time, row, row + 1, m_texels.data());
+            m_generated.store(++row, std::memory_order_release);
+        }
+        m_busy.store(false, std::memory_order_release);
+    });
+}
+
+void CloudLayer::update(float deltaTime) {
+    if (!isActive()) return;
+
+    m_time += deltaTime * SPEED;
+    m_drift = std::fmod(m_drift + deltaTime * DRIFT, 1.f);
+
+    // Rows below m_generated are no longer written, the worker only moves past it
+    int width = m_job.resolution * 2;
+    int generated = m_generated.load(std::memory_order_acquire);
+    if (generated > m_uploaded) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_textures[2]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, m_uploaded, width, generated - m_uploaded,
+                        GL_RED, GL_UNSIGNED_BYTE, m_texels.data() + std::size_t(m_uploaded) * width);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_uploaded = generated;
+    }
+
+    if (m_busy.load(std::memory_order_acquire)) return;
+
+    // Both complete keyframes are the first one, so the first next keyframe is taken as far ahead
+    // as the layer moves while the worker generates it, one BUDGET_US slice per update
+    if (m_next_time < 0) {
+        m_next_time = std::ceil(m_keyframe_us / BUDGET_US) * deltaTime * SPEED;
+    }
+
+    // The next keyframe is complete and shown in full: it becomes the current one, the previous
+    // one is recycled, and the new next keyframe is taken at the layer's present time, so that
+    // keyframes are as far apart as the layer moves while one is generated
+    if (m_uploaded == m_job.resolution) {
+        std::rotate(m_textures, m_textures + 1, m_textures + 3);
+        m_uploaded = 0;
+        m_generated.store(0, std::memory_order_relaxed);
+        m_next_time = m_time;
+    }
+    submitSlice();
+}
+
+void CloudLayer::bind(GLuint shader, int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, m_textures[0]);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, m_textures[1]);
+
+    glUniform1i(glGetUniformLocation(shader, "cloud_prev"), unit);
+    glUniform1i(glGetUniformLocation(shader, "cloud_next"), unit + 1);
+    glUniform1f(glGetUniformLocation(shader, "cloud_blend"), float(m_uploaded) / m_job.resolution);
+    glUniform1f(glGetUniformLocation(shader, "cloud_drift"), m_drift);
+}
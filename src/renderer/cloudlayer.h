@@ -0,0 +1,70 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+#include "utils/workstealingpool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// An animated cloud layer that is regenerated a time slice at a time. Three R8 keyframes of the
+// cloud job at successive times live on the GPU: the two newest complete ones, which the planet
+// shader crossfades, and the next one, whose rows a background worker generates for at most
+// BUDGET_US per tick and which are uploaded with glTexSubImage2D as they complete. The crossfade
+// follows the next keyframe's progress, so by the time it is complete the shown clouds have
+// reached the newest one and the three rotate without a jump. The GL thread never waits on the
+// worker, and it uploads no more than a slice's rows per tick, so frame times stay flat.
+class CloudLayer {
+public:
+    ~CloudLayer();
+
+    // Creates the keyframes, generating the first one right away. GL thread only.
+    void start(const TerrainGenerator *terrain, unsigned int seed, int resolution);
+
+    // Waits for the worker and releases the keyframes. GL thread only.
+    void stop();
+
+    bool isActive() const { return m_textures[0] != 0; };
+
+    // GL thread with a current context, once per frame: advances the layer's time by deltaTime seconds, uploads the rows
+    // the worker finished since the last tick, rotates the keyframes once the next one is
+    // complete, and hands the worker its next slice
+    void update(float deltaTime);
+
+    // Binds the keyframes being crossfaded to texture units unit and unit + 1, and sets the
+    // shader's cloud uniforms
+    void bind(GLuint shader, int unit) const;
+
+    // Worker time per tick, in microseconds
+    inline static const int BUDGET_US = 2000;
+
+    // Noise units per second the clouds move through the sphere, and turns per second they drift
+    inline static const float SPEED = 0.02f;
+    inline static const float DRIFT = 0.004f;
+
+private:
+    void submitSlice();
+
+    const TerrainGenerator *m_terrain = nullptr;
+    TerrainJob m_job;
+    std::unique_ptr<WorkStealingPool> m_pool;   // a single worker
+    std::vector<std::uint8_t> m_texels;         // the next keyframe, filled row by row
+
+    GLuint m_textures[3] = {};          // previous, current and next keyframe
+    float m_time = 0;                   // layer time, advanced by update()
+    float m_next_time = 0;              // time of the next keyframe, negative until first chosen
+    float m_keyframe_us = 0;            // worker time a keyframe takes, measured by start()
+    float m_drift = 0;                  // turns the layer has drifted, in [0, 1)
+    int m_uploaded = 0;                 // rows of the next keyframe on the GPU
+
+    std::atomic<int> m_generated = 0;   // rows of the next keyframe the worker has finished
+    std::atomic<bool> m_busy = false;   // a slice is queued or running
+};
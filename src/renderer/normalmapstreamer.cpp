@@ -0,0 +1,163 @@
+#include "renderer/normalmapstreamer.h"
+#include "utils/blockcompressor.h"
+
+#include <algorithm>
+#include <iostream>
+
+NormalMapStreamer::~NormalMapStreamer() {
+    // Queued blocks are dropped, running ones finish into maps nobody will upload
+    m_cancel = true;
+    m_pool.reset();
+}
+
+// Specifies the 2D texture's (2 * resolution) x resolution image from RG8 texels or BC5 blocks.
+// Rows of 2 * resolution RG8 texels are a multiple of 4 bytes, the default unpack alignment.
+static void texImage(GLuint texture, int resolution, const void *data, bool compressed) {
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (compressed) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RG_RGTC2, resolution * 2, resolution, 0,
+                               BlockCompressor::bc5Size(resolution * 2, resolution), data);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, resolution * 2, resolution, 0, GL_RG, GL_UNSIGNED_BYTE, data);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void NormalMapStreamer::upload(GLuint texture, int resolution, const void *texels) {
+    texImage(texture, resolution, texels, false);
+    m_resolutions[texture] = resolution;
+    m_compressed.erase(texture);
+}
+
+int NormalMapStreamer::enqueue(const TerrainGenerator *terrain, TextureCache *cache, std::vector<Request> requests) {
+    m_terrain = terrain;
+    if (m_outstanding == 0) {
+        m_timer.start();
+        m_streamed = 0;
+    }
+    if (m_pool == nullptr) m_pool = std::make_unique<WorkStealingPool>();
+
+    int hits = 0;
+    for (auto &request: requests) {
+        auto &job = request.job;
+        qint64 size = qint64(job.resolution) * job.resolution * 2 * 2;
+        auto map = std::make_shared<Map>();
+
+        // Cache hits are shown straight from the mapped file; only their encoding is left to do.
+        // Persisted misses are generated into their cache file.
+        if (request.persistent) {
+            map->entry = cache->load(request.key, size);
+            if (map->entry != nullptr) {
+                hits += 1;
+                map->generate = false;
+                upload(request.texture, job.resolution, map->entry->data());
+                if (!request.compressed) continue;
+            } else {
+                map->entry = cache->create(request.key, size);
+            }
+        }
+        if (map->entry != nullptr) {
+            map->texels = static_cast<std::uint8_t *>(map->entry->data());
+        } else {
+            map->normals.resize(size);
+            map->texels = map->normals.data();
+        }
+        if (request.compressed) map->blocks.resize(BlockCompressor::bc5Size(job.resolution * 2, job.resolution));
+        map->request = std::move(request);
+        submit(map);
+    }
+    return hits;
+}
+
+void NormalMapStreamer::submit(const std::shared_ptr<Map> &map) {
+    int resolution = map->request.job.resolution;
+    map->remaining = (resolution + ROW_BLOCK - 1) / ROW_BLOCK;
+    m_outstanding += 1;
+
+    for (int row = 0; row < resolution; row += ROW_BLOCK) {
+        m_pool->submit([this, map, row]() {
+            auto &job = map->request.job;
+            int end = std::min(row + ROW_BLOCK, job.resolution);
+            if (!m_cancel) {
+                if (map->generate) m_terrain->generateNormalRows(job, row, end, map->texels);
+
+                // Row blocks are whole blocks, since resolutions and ROW_BLOCK are multiples of 4
+                if (!map->blocks.empty()) {
+                    int width = job.resolution * 2;
+                    std::size_t stride = std::size_t(width) * 2;
+                    std::size_t block_stride = BlockCompressor::bc5Size(width, 4);
+                    BlockCompressor::encodeBC5Blocks(map->texels + row * stride, stride, width, end - row,
+                                                     map->blocks.data() + row / 4 * block_stride, block_stride);
+                }
+            }
+
+            // The last block hands the map back, even if cancelled, for stop() to drop
+            if (map->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_finished.push_back(map);
+            }
+        });
+    }
+}
+
+void NormalMapStreamer::stop() {
+    if (m_pool != nullptr) {
+        m_cancel = true;
+        m_pool->wait();
+        m_cancel = false;
+    }
+
+    // Every map is among the finished ones now; uncommitted cache entries are discarded with them
+    m_finished.clear();
+    m_outstanding = 0;
+    m_resolutions.clear();
+    m_compressed.clear();
+}
+
+void NormalMapStreamer::update() {
+    for (int i = 0; i < MAX_UPLOADS_PER_FRAME; ++i) {
+        std::shared_ptr<Map> map;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_finished.empty()) break;
+            map = std::move(m_finished.front());
+            m_finished.pop_front();
+        }
+        m_outstanding -= 1;
+
+        // A map replaces a blurrier image, or the same one uncompressed, and is dropped if a
+        // sharper one has been uploaded meanwhile
+        auto &request = map->request;
+        int resolution = request.job.resolution;
+        int current = m_resolutions.count(request.texture) ? m_resolutions[request.texture] : 0;
+        bool compressed = !map->blocks.empty();
+        if (resolution > current || (resolution == current && compressed && !m_compressed.count(request.texture))) {
+            texImage(request.texture, resolution, compressed ? map->blocks.data() : map->texels, compressed);
+            m_resolutions[request.texture] = resolution;
+            if (compressed) {
+                m_compressed.insert(request.texture);
+                m_streamed_bytes += std::size_t(resolution) * resolution * 2 * 2;
+                m_compressed_bytes += map->blocks.size();
+            } else {
+                m_compressed.erase(request.texture);
+            }
+        }
+
+        // A generated map is complete whether or not it was shown, so it is kept either way
+        if (map->generate && map->entry != nullptr) map->entry->commit();
+        m_streamed += 1;
+    }
+
+    if (m_streamed > 0 && m_outstanding == 0) {
+        std::cout << "Streamed " << m_streamed << " normal maps in " << m_timer.elapsed() << " ms";
+        if (m_compressed_bytes > 0) {
+            std::cout << ", BC5 saved " << (m_streamed_bytes - m_compressed_bytes) / 1024 << " of "
+                      << m_streamed_bytes / 1024 << " KiB";
+        }
+        std::cout << std::endl;
+        m_streamed = 0;
+        m_streamed_bytes = 0;
+        m_compressed_bytes = 0;
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+#include "utils/texturecache.h"
+#include "utils/workstealingpool.h"
+
+#include <QElapsedTimer>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Generates RG8 normal maps in the background for textures that already hold a low-tier preview.
+// Each map's rows are split into blocks of ROW_BLOCK rows, and the blocks of all outstanding maps
+// are spread over a work-stealing pool. Persisted maps are generated straight into their created
+// cache entry. Compressed maps are also encoded to BC5 block by block, by the worker that generated
+// the rows, as TextureStreamer encodes BC1 by tile. A map is uploaded whole, with glTexImage2D or
+// glCompressedTexImage2D, on the first frame after its last block is done, so the GL thread
+// neither generates nor encodes.
+class NormalMapStreamer {
+public:
+    struct Request {
+        GLuint texture;             // 2D texture to replace
+        TerrainJob job;             // full-resolution job
+        bool persistent;            // served from the cache, or stored in it once generated
+        TextureCache::Key key;
+        bool compressed = false;    // end up as BC5, see BlockCompressor
+    };
+
+    ~NormalMapStreamer();
+
+    // Uploads a resolution's (2 * resolution) x resolution RG8 texels right away, e.g. a preview.
+    // Results of requests at that resolution or below no longer replace them. GL thread only.
+    void upload(GLuint texture, int resolution, const void *texels);
+
+    // Uploads every persistent request that is cached right away, and queues the rest behind the
+    // outstanding ones; cached maps that end up compressed are shown uncompressed until their
+    // blocks are encoded. Returns the number of cache hits. GL thread only.
+    int enqueue(const TerrainGenerator *terrain, TextureCache *cache, std::vector<Request> requests);
+
+    // Cancels outstanding work and waits for the workers to go idle. GL thread only.
+    void stop();
+
+    // GL thread, once per frame: uploads at most MAX_UPLOADS_PER_FRAME finished maps and commits
+    // the cache entries of the generated ones
+    void update();
+
+    inline static const int ROW_BLOCK = 16;
+
+private:
+    // A request whose row blocks are being generated or encoded
+    struct Map {
+        Request request;
+        std::unique_ptr<TextureCache::Entry> entry; // cached map, or destination of a persisted one
+        std::vector<std::uint8_t> normals;          // destination of a map that is not persisted
+        std::uint8_t *texels = nullptr;
+        std::vector<std::uint8_t> blocks;           // BC5 blocks of a compressed map
+        bool generate = true;                       // false if the texels are cached
+        std::atomic<int> remaining = 0;             // row blocks not yet done
+    };
+
+    void submit(const std::shared_ptr<Map> &map);
+
+    const TerrainGenerator *m_terrain = nullptr;
+
+    std::unique_ptr<WorkStealingPool> m_pool;
+    std::atomic<bool> m_cancel = false;
+
+    std::mutex m_mutex;
+    std::deque<std::shared_ptr<Map>> m_finished;   // guarded by m_mutex
+
+    // GL thread only
+    int m_outstanding = 0;                      // maps queued but not yet uploaded or dropped
+    std::unordered_map<GLuint, int> m_resolutions;  // current resolution of every texture we uploaded
+    std::unordered_set<GLuint> m_compressed;    // textures whose image is BC5
+    QElapsedTimer m_timer;                      // since the queue last became busy
+    int m_streamed = 0;
+    std::size_t m_streamed_bytes = 0;           // RG8 size of the compressed maps streamed
+    std::size_t m_compressed_bytes = 0;         // and of their blocks
+
+    // A 2048 x 1024 map is 4 MiB of RG8, a couple of them per frame keep the frame time flat
+    inline static const int MAX_UPLOADS_PER_FRAME = 2;
+};
@@ -0,0 +1,296 @@
+#include "renderer/planetterrain.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Vertices along a chunk's side, and in its grid
+static const int SIDE = PlanetTerrain::QUADS + 1;
+static const int GRID_VERTICES = SIDE * SIDE;
+
+// Depth of a chunk's skirt per face unit of its width, well below the height differences
+// between the octaves a chunk and its smaller neighbours resolve
+static const float SKIRT_DEPTH = 0.05f;
+
+// Whether the face's grid, with columns along sc and rows along tc, winds clockwise seen from
+// outside the sphere
+static bool isFlipped(int face) {
+    auto origin = TerrainGenerator::getCubeDirection(face, 0, 0);
+    auto along_s = TerrainGenerator::getCubeDirection(face, 1, 0) - origin;
+    auto along_t = TerrainGenerator::getCubeDirection(face, 0, 1) - origin;
+    return glm::dot(glm::cross(along_s, along_t), origin) < 0;
+}
+
+// Index of the vertex k along edge e of the grid: bottom, top, left, right
+static int borderVertex(int edge, int k) {
+    switch (edge) {
+        case 0: return k;
+        case 1: return PlanetTerrain::QUADS * SIDE + k;
+        case 2: return k * SIDE;
+        default: return k * SIDE + PlanetTerrain::QUADS;
+    }
+}
+
+PlanetTerrain::~PlanetTerrain() {
+    // Queued chunks are dropped, running ones finish into results nobody will upload
+    m_pool.reset();
+}
+
+void PlanetTerrain::start(const TerrainGenerator *terrain, const TerrainJob &job) {
+    stop();
+
+    m_terrain = terrain;
+    m_job = job;
+    m_frame = 0;
+
+    // Every chunk shares its triangles, in either winding. Skirt vertices follow the grid's, one
+    // below each border vertex, edge by edge.
+    glGenBuffers(2, m_indices);
+    for (int flipped = 0; flipped < 2; ++flipped) {
+        std::vector<GLuint> indices;
+        indices.reserve(TRIANGLES_PER_CHUNK * 3);
+        for (int r = 0; r < QUADS; ++r) {
+            for (int c = 0; c < QUADS; ++c) {
+                GLuint i = r * SIDE + c;
+                if (!flipped) {
+                    indices.insert(indices.end(), { i, i + 1, i + SIDE, i + 1, i + SIDE + 1, i + SIDE });
+                } else {
+                    indices.insert(indices.end(), { i, i + SIDE, i + 1, i + 1, i + SIDE, i + SIDE + 1 });
+                }
+            }
+        }
+        for (int edge = 0; edge < 4; ++edge) {
+            for (int k = 0; k < QUADS; ++k) {
+                GLuint a = borderVertex(edge, k), b = borderVertex(edge, k + 1);
+                GLuint a_skirt = GRID_VERTICES + edge * SIDE + k, b_skirt = a_skirt + 1;
+                indices.insert(indices.end(), { a, b, b_skirt, a, b_skirt, a_skirt,
+                                                a, b_skirt, b, a, a_skirt, b_skirt });
+            }
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices[flipped]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // The faces themselves are drawn until their children are ready
+    m_pool = std::make_unique<WorkStealingPool>();
+    for (int face = 0; face < 6; ++face) {
+        request(Chunk { 0, face, 0, 0 });
+    }
+    m_pool->wait();
+    uploadResults(6);
+    for (int face = 0; face < 6; ++face) {
+        m_selected.push_back(Chunk { 0, face, 0, 0 }.key());
+    }
+}
+
+void PlanetTerrain::stop() {
+    // Waits for the running chunks, queued ones are dropped
+    m_pool.reset();
+    m_results.clear();
+    m_in_flight.clear();
+    m_split.clear();
+    m_selected.clear();
+
+    for (auto &[key, mesh]: m_meshes) {
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.vbo_tangent);
+        glDeleteVertexArrays(1, &mesh.vao);
+    }
+    m_meshes.clear();
+    if (m_indices[0] != 0) {
+        glDeleteBuffers(2, m_indices);
+        m_indices[0] = m_indices[1] = 0;
+    }
+}
+
+void PlanetTerrain::request(const Chunk &chunk) {
+    m_in_flight.insert(chunk.key());
+    m_pool->submit([this, chunk]() {
+        float size = 2.f / (1 << chunk.level);
+        Result result;
+        result.chunk = chunk;
+        auto &vertices = result.vertices;
+        vertices = m_terrain->generateTerrainDisplacement(m_job, chunk.face, -1 + chunk.col * size,
+                                                          -1 + chunk.row * size, size, QUADS);
+
+        // Skirts hang straight down from the border vertices, with the same normal and uv
+        float lower = 1 - SKIRT_DEPTH * size;
+        vertices.reserve((GRID_VERTICES + 4 * SIDE) * 8);
+        for (int edge = 0; edge < 4; ++edge) {
+            for (int k = 0; k < SIDE; ++k) {
+                int border = borderVertex(edge, k) * 8;
+                for (int i = 0; i < 8; ++i) vertices.push_back(vertices[border + i] * (i < 3 ? lower : 1.f));
+            }
+        }
+
+        // Tangents along u and v, east and north, as for the normal maps
+        int count = int(vertices.size()) / 8;
+        result.tangents.reserve(count * 6);
+        for (int v = 0; v < count; ++v) {
+            auto dir = glm::normalize(glm::vec3(vertices[v * 8], vertices[v * 8 + 1], vertices[v * 8 + 2]));
+            auto east = glm::vec3(dir.z, 0, -dir.x);
+            east = glm::length(east) > 1e-6f ? glm::normalize(east) : glm::vec3(1, 0, 0);
+            auto north = glm::cross(dir, east);
+            result.tangents.insert(result.tangents.end(), { east.x, east.y, east.z, north.x, north.y, north.z });
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(result));
+    });
+}
+
+void PlanetTerrain::evict() {
+    // The least recently used mesh that is neither a face nor needed this frame
+    auto victim = m_meshes.end();
+    for (auto it = m_meshes.begin(); it != m_meshes.end(); ++it) {
+        if (it->second.used == m_frame || (it->first >> 40) == 0) continue;
+        if (victim == m_meshes.end() || it->second.used < victim->second.used) victim = it;
+    }
+    if (victim == m_meshes.end()) return;
+
+    glDeleteBuffers(1, &victim->second.vbo);
+    glDeleteBuffers(1, &victim->second.vbo_tangent);
+    glDeleteVertexArrays(1, &victim->second.vao);
+    m_meshes.erase(victim);
+}
+
+void PlanetTerrain::uploadResults(int max) {
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int count = std::min(max, int(m_results.size()));
+        std::move(m_results.begin(), m_results.begin() + count, std::back_inserter(results));
+        m_results.erase(m_results.begin(), m_results.begin() + count);
+    }
+
+    for (auto &result: results) {
+        auto key = result.chunk.key();
+        m_in_flight.erase(key);
+        if (int(m_meshes.size()) >= MAX_MESHES) evict();
+
+        Mesh mesh;
+        mesh.flipped = isFlipped(result.chunk.face);
+        mesh.used = m_frame;
+        glGenVertexArrays(1, &mesh.vao);
+        glBindVertexArray(mesh.vao);
+
+        // Position, normal and uv, then tangent and bitangent, at the shapes' attribute locations
+        glGenBuffers(1, &mesh.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, result.vertices.size() * sizeof(GLfloat), result.vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void *>(0));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void *>(3 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), reinterpret_cast<void *>(6 * sizeof(GLfloat)));
+
+        glGenBuffers(1, &mesh.vbo_tangent);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo_tangent);
+        glBufferData(GL_ARRAY_BUFFER, result.tangents.size() * sizeof(GLfloat), result.tangents.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<void *>(0));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), reinterpret_cast<void *>(3 * sizeof(GLfloat)));
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices[mesh.flipped]);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        m_meshes[key] = mesh;
+    }
+}
+
+void PlanetTerrain::update(glm::vec3 camera, glm::vec3 look, float coneAngle) {
+    if (!isActive()) return;
+    ++m_frame;
+
+    // Chunks on the near side of the horizon and inside the view cone, from the six faces down.
+    // The chunk the camera is nearest to, relative to its width, is split first, while the
+    // chunks drawn stay within budget. Chunks are bounded by the cap around their center
+    // direction through their farthest corner, widened by the relief.
+    float distance = std::max(glm::length(camera), 0.5f);
+    auto view = glm::normalize(camera);
+    float horizon = std::acos(std::min(0.5f * (1 - TerrainGenerator::TERRAIN_RELIEF) / distance, 1.f));
+    std::vector<std::pair<float, Chunk>> queue;     // heap of visible chunks by width over distance
+    auto byNearness = [](const auto &a, const auto &b) { return a.first < b.first; };
+    auto consider = [&](const Chunk &chunk) {
+        float step = 2.f / (1 << chunk.level);
+        float sc = -1 + chunk.col * step;
+        float tc = -1 + chunk.row * step;
+        auto center = glm::normalize(TerrainGenerator::getCubeDirection(chunk.face, sc + step / 2, tc + step / 2));
+        float cos_radius = 1;
+        for (int corner = 0; corner < 4; ++corner) {
+            auto dir = TerrainGenerator::getCubeDirection(chunk.face, sc + step * (corner & 1), tc + step * (corner >> 1));
+            cos_radius = std::min(cos_radius, glm::dot(center, glm::normalize(dir)));
+        }
+        float radius = std::acos(cos_radius);
+        float angle = std::acos(std::clamp(glm::dot(center, view), -1.f, 1.f));
+        float nearest_angle = std::max(angle - radius, 0.f);
+        if (nearest_angle > horizon) return;
+
+        auto offset = 0.5f * center - camera;
+        float bound = std::sin(radius / 2) + 0.5f * TerrainGenerator::TERRAIN_RELIEF;
+        float length = glm::length(offset);
+        if (length > bound) {
+            float off_axis = std::acos(std::clamp(glm::dot(offset / length, look), -1.f, 1.f));
+            if (off_axis - std::asin(bound / length) > coneAngle) return;
+        }
+
+        // A chunk is about step / 2 wide on the sphere of radius 0.5
+        float nearest = std::sqrt(distance * distance + 0.25f - distance * std::cos(nearest_angle));
+        queue.emplace_back(step / 2 / std::max(nearest, 1e-6f), chunk);
+        std::push_heap(queue.begin(), queue.end(), byNearness);
+    };
+
+    for (int face = 0; face < 6; ++face) {
+        consider(Chunk { 0, face, 0, 0 });
+    }
+    std::unordered_set<std::uint64_t> split;
+    m_selected.clear();
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), byNearness);
+        auto [nearness, chunk] = queue.back();
+        queue.pop_back();
+        auto key = chunk.key();
+        m_meshes.at(key).used = m_frame;
+
+        // Split chunks merge only once the camera is a quarter farther than where they split
+        float threshold = 1 / (LOD_DISTANCE * (m_split.count(key) ? 1.25f : 1.f));
+        bool wanted = chunk.level < MAX_LEVEL && nearness > threshold
+                      && int(m_selected.size() + queue.size()) + 3 <= MAX_CHUNKS;
+        if (wanted) {
+            Chunk children[4];
+            bool ready = true;
+            for (int child = 0; child < 4; ++child) {
+                children[child] = Chunk { chunk.level + 1, chunk.face, chunk.row * 2 + (child >> 1), chunk.col * 2 + (child & 1) };
+                // Children waiting for their siblings are kept from eviction too
+                auto child_key = children[child].key();
+                auto it = m_meshes.find(child_key);
+                if (it != m_meshes.end()) {
+                    it->second.used = m_frame;
+                    continue;
+                }
+                ready = false;
+                if (!m_in_flight.count(child_key) && int(m_in_flight.size()) < MAX_IN_FLIGHT) request(children[child]);
+            }
+            if (ready) {
+                split.insert(key);
+                for (auto &child: children) consider(child);
+                continue;
+            }
+        }
+        m_selected.push_back(key);
+    }
+    m_split = std::move(split);
+
+    uploadResults(MAX_UPLOADS_PER_FRAME);
+}
+
+void PlanetTerrain::draw() const {
+    for (auto key: m_selected) {
+        glBindVertexArray(m_meshes.at(key).vao);
+        glDrawElements(GL_TRIANGLES, TRIANGLES_PER_CHUNK * 3, GL_UNSIGNED_INT, nullptr);
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+#include "utils/workstealingpool.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// The displaced surface of the planet the camera orbits, as a quadtree of chunks over the six
+// faces of a cube projected onto the sphere. Every chunk is a QUADS x QUADS grid of vertices
+// raised by the planet's noise heights, see TerrainGenerator::generateTerrainDisplacement(), so
+// a chunk four times smaller has four times the detail. Each frame, chunks on the near side of
+// the horizon and inside the view cone are split while the camera is within LOD_DISTANCE chunk
+// widths of them, and merged again once it is a quarter farther, so chunks don't flicker at the
+// threshold. At most MAX_CHUNKS are drawn, the nearest refined first, which bounds the triangle
+// count however closely the camera skims the surface. Chunk meshes are built on a worker pool
+// and uploaded a few per frame; a chunk is only split once its four children are uploaded, so the
+// surface never has holes, and meshes are kept until evicted by more recently drawn ones. Chunks
+// of different sizes meet at different heights, so every chunk hangs a skirt from its borders
+// that hides the cracks between them.
+class PlanetTerrain {
+public:
+    ~PlanetTerrain();
+
+    // Drops every chunk and starts over for the job's planet, building the six root chunks right
+    // away. GL thread only.
+    void start(const TerrainGenerator *terrain, const TerrainJob &job);
+
+    // Waits for the workers and releases every mesh. GL thread only.
+    void stop();
+
+    bool isActive() const { return !m_meshes.empty(); };
+
+    // GL thread, once per frame: selects the chunks to draw, given the camera's position and unit
+    // view direction in the planet's object space, where the undisplaced sphere has radius 0.5,
+    // and the half angle of a cone around the view direction that holds the view frustum; queues
+    // the meshes of chunks that should be split, and uploads at most MAX_UPLOADS_PER_FRAME of them
+    void update(glm::vec3 camera, glm::vec3 look, float coneAngle);
+
+    // Draws the selected chunks with the current shader program, whose vertex attributes are
+    // those of the shapes' meshes, tangents included
+    void draw() const;
+
+    // Triangles draw() submits, skirts included
+    int getTriangleCount() const { return int(m_selected.size()) * TRIANGLES_PER_CHUNK; };
+
+    inline static const int QUADS = 32;
+    inline static const int MAX_LEVEL = 12;
+    inline static const int MAX_CHUNKS = 160;
+    inline static const float LOD_DISTANCE = 3.f;
+
+    // Meshes built at once, uploaded per frame, and kept around
+    inline static const int MAX_IN_FLIGHT = 16;
+    inline static const int MAX_UPLOADS_PER_FRAME = 4;
+    inline static const int MAX_MESHES = 2 * MAX_CHUNKS;
+
+private:
+    struct Chunk {
+        int level;      // 0 for the faces themselves
+        int face;
+        int row;
+        int col;
+
+        std::uint64_t key() const {
+            return (std::uint64_t(level) << 40) | (std::uint64_t(face) << 32) | (std::uint64_t(row) << 16) | col;
+        };
+    };
+
+    struct Mesh {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint vbo_tangent = 0;
+        bool flipped = false;       // the face's grid winds clockwise seen from outside
+        std::uint64_t used = 0;     // frame the mesh was last drawn or needed in
+    };
+
+    struct Result {
+        Chunk chunk;
+        std::vector<float> vertices;
+        std::vector<float> tangents;
+    };
+
+    // Grid triangles, whose winding the faces' orientations decide, plus double-sided skirts
+    inline static const int TRIANGLES_PER_CHUNK = QUADS * QUADS * 2 + 4 * QUADS * 4;
+
+    void request(const Chunk &chunk);
+    void uploadResults(int max);
+    void evict();
+
+    const TerrainGenerator *m_terrain = nullptr;
+    TerrainJob m_job;
+    std::unique_ptr<WorkStealingPool> m_pool;
+
+    std::mutex m_mutex;
+    std::vector<Result> m_results;          // guarded by m_mutex
+
+    // GL thread only
+    GLuint m_indices[2] = {};               // counterclockwise and clockwise grids
+    std::unordered_map<std::uint64_t, Mesh> m_meshes;
+    std::unordered_set<std::uint64_t> m_in_flight;
+    std::unordered_set<std::uint64_t> m_split;  // chunks split in the last frame
+    std::vector<std::uint64_t> m_selected;      // chunks drawn by draw()
+    std::uint64_t m_frame = 0;
+};
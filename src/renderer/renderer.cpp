@@ -7,8 +7,11 @@
 #include "shape/ring.h"
 #include "settings.h"
 
+#include <QElapsedTimer>
+#include <algorithm>
 #include <iostream>
 #include <numeric>
+#include <random>
 
 // VAO configs
 std::vector<int> VAO_POS_NORM_UV_CONFIG { 3, 3, 2 };
@@ -24,6 +27,12 @@ std::vector<PrimitiveType> IMPLICIT_SHAPES {
     PrimitiveType::PRIMITIVE_RING,
 };
 
+// Resolution of the placeholder color and normal maps shown while the full maps are generated
+const int PREVIEW_RESOLUTION = 32;
+
+// Resolution of the cloud layer, a 1024 x 512 map that is regenerated a few rows per tick
+const int CLOUD_RESOLUTION = 512;
+
 // Fullscreem Quad
 std::vector<GLfloat> FULLSCREEN_QUAD_DATA =
 { //     POSITIONS    //
@@ -85,6 +94,10 @@ void Renderer::initialize(int screen_w, int screen_h) {
     // Initialize the fullscreen quad mesh to project on and the FBO
     m_fullscreen_mesh = bindMesh(FULLSCREEN_QUAD_DATA, VAO_POS_UV_CONFIG);
     generateFBO();
+    m_baker.initialize(m_fullscreen_mesh.vao);
+
+    // Procedural color maps are cube maps, filter across their face edges
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
     // Final Project
     m_line_shader = ShaderLoader::createShaderProgram(
@@ -94,7 +107,8 @@ void Renderer::initialize(int screen_w, int screen_h) {
 
     m_planet_shader = ShaderLoader::createShaderProgram(
                 "resources/shaders/phong.vert",
-                "resources/shaders/planet.frag"
+                "resources/shaders/planet.frag",
+                "resources/shaders/planetsurface.glsl"
     );
 }
 
@@ -164,7 +178,14 @@ void Renderer::updateScene(int width, int height) {
     clearTextureData();
     updateGeometry();
     generateTextures();
-    generateNormalMap();
+    generateNormalMaps();
+    // Only planets with climates are clouded, and the solar system's maps have none
+    bool clouded = std::any_of(m_procedural_jobs.begin(), m_procedural_jobs.end(),
+                               [](const auto &it) { return it.second.biomes != nullptr; });
+    if (settings.clouds && clouded) {
+        m_clouds.start(&m_terrain, settings.textureSeed, CLOUD_RESOLUTION);
+    }
+    m_cloud_time = 0;
 
     m_ready = true;
 }
@@ -174,6 +195,11 @@ void Renderer::updatePlanets(float deltaTime) {
     m_ps.update(deltaTime);
 }
 
+void Renderer::updateClouds(float deltaTime) {
+    // Called from the timer, which has no current context, so render() does the uploads
+    m_cloud_time += deltaTime;
+}
+
 // Recompute the mesh data for each type of implicit objects
 void Renderer::updateGeometry() {
     int param1 = settings.shapeParameter1;
@@ -186,68 +212,147 @@ void Renderer::updateGeometry() {
 
 }
 
+// Cache key of a job's RGBA8 color map; every resolution tier and layout is cached separately
+static TextureCache::Key colorMapKey(const TerrainJob &job) {
+    return TextureCache::Key { job.name, job.seed, job.width(), job.height(),
+                               (int)TexelFormat::RGBA8, TerrainGenerator::VERSION };
+}
+
+// Cache key of a job's RG8 normal map, which is 2:1 in either layout
+static TextureCache::Key normalMapKey(const TerrainJob &job) {
+    return TextureCache::Key { job.name, job.seed, job.resolution * 2, job.resolution,
+                               (int)TexelFormat::RG8, TerrainGenerator::VERSION };
+}
+
+// Request for a job's normal map, to be generated or served from the cache
+NormalMapStreamer::Request Renderer::normalMapRequest(GLuint texture, const TerrainJob &job) const {
+    return NormalMapStreamer::Request { texture, job, m_persistent_textures, normalMapKey(job), m_compressed_textures };
+}
+
+// Height in pixels the shape's sphere covers from the current camera position
+float Renderer::getScreenDiameter(RenderShapeData *shape) const {
+    auto center = glm::vec3(shape->ctm[3]);
+    auto radius = 0.5f * glm::length(glm::vec3(shape->ctm[0]));
+    return m_camera.getScreenDiameter(center, radius, m_screen_height);
+}
+
+// Whether color maps end up as BC1, which is an extension of GL 3.3 that nearly every desktop driver has
+bool Renderer::compressColorMaps() const {
+    return m_compressed_textures && GLEW_EXT_texture_compression_s3tc;
+}
+
+// Uploads the job's color map from the disk cache if it is persistent and cached
+bool Renderer::loadCachedColorMap(GLuint texture, const TerrainJob &job) {
+    if (!m_persistent_textures) return false;
+
+    auto entry = m_texture_cache.load(colorMapKey(job), qint64(job.width()) * job.height() * 4);
+    if (entry == nullptr) return false;
+
+    m_streamer.upload(texture, job.cubemap, job.width(), job.height(), entry->data(), compressColorMaps());
+    return true;
+}
+
 // Creates a mapping between texture filename and GL Texture
 void Renderer::generateTextures() {
+    // Draw every color map's noise and palette up front; generation itself runs in the background.
+    // The solar system's maps use fixed seeds so they can be served from the disk cache on later
+    // loads; a procedural system is new every time, so its maps are neither looked up nor stored.
+    std::vector<std::pair<int, TerrainJob>> jobs;
+    bool persistent = !settings.procedural;
     if (!settings.procedural) {
         for (int i = 0; i < planet_type_count; ++i) {
-            auto color = m_terrain.generateTerrainColors(i);
-            auto resolution = m_terrain.getResolution();
-            GLuint color_map;
-            glGenTextures(1, &color_map);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, color_map);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                         resolution * 2, resolution, 0,
-                         GL_RGBA, GL_FLOAT, color.data());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            m_procedural_texture_map[i] = color_map;
-            glBindTexture(GL_TEXTURE_2D, 0);
+            jobs.emplace_back(i, m_terrain.createJob(i, settings.textureSeed + i));
         }
     } else {
+        std::random_device rd;
         int div = settings.numPlanet / 2 + 1;
 
         for (int i = 0; i < settings.numPlanet; ++i) {
-            std::vector<float> color;
             if (i == 0) {
-                color = m_terrain.generateTerrainColors(PlanetType::PLANET_SUN);
+                jobs.emplace_back(i, m_terrain.createJob(PlanetType::PLANET_SUN, rd()));
             } else if (i <= div) {
-                color = m_terrain.generateTerrainColors(PlanetType::PLANET_ROCKY);
+                jobs.emplace_back(i, m_terrain.createJob(PlanetType::PLANET_ROCKY, rd()));
             } else {
-                color = m_terrain.generateTerrainColors(PlanetType::PLANET_GAS);
+                jobs.emplace_back(i, m_terrain.createJob(PlanetType::PLANET_GAS, rd()));
             }
-
-            auto resolution = m_terrain.getResolution();
-            GLuint color_map;
-            glGenTextures(1, &color_map);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, color_map);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                         resolution * 2, resolution, 0,
-                         GL_RGBA, GL_FLOAT, color.data());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            m_procedural_texture_map[i] = color_map;
-            glBindTexture(GL_TEXTURE_2D, 0);
         }
 
         for (int i = settings.numPlanet; i < settings.numPlanet + m_ps.getNumMoon(); ++i) {
-            auto color = m_terrain.generateTerrainColors(PlanetType::PLANET_MOON);
-            auto resolution = m_terrain.getResolution();
-            GLuint color_map;
-            glGenTextures(1, &color_map);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, color_map);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                         resolution * 2, resolution, 0,
-                         GL_RGBA, GL_FLOAT, color.data());
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            m_procedural_texture_map[i] = color_map;
-            glBindTexture(GL_TEXTURE_2D, 0);
+            jobs.emplace_back(i, m_terrain.createJob(PlanetType::PLANET_MOON, rd()));
+        }
+    }
+
+    // Size every map for the largest footprint its bodies have from the starting view: in orbit
+    // mode the orbited body at the default distance, the rest as seen from the free camera
+    if (settings.orbitCamera) {
+        m_camera.updateCameraView(m_data.shapes[m_camera_at]);
+    }
+    std::unordered_map<int, float> footprints;
+    for (auto &shape: m_data.shapes) {
+        footprints[shape->type] = std::max(footprints[shape->type], getScreenDiameter(shape));
+    }
+
+    // Every map gets its texture right away: baked maps are rendered on the GPU, cache hits upload
+    // straight from the mapped file, misses start with a small preview that the streamer refines
+    // in place once generated
+    QElapsedTimer timer;
+    timer.start();
+    m_texture_cache.resetStats();
+    m_persistent_textures = persistent;
+    m_compressed_textures = settings.compressTextures;
+    if (m_compressed_textures && !GLEW_EXT_texture_compression_s3tc) {
+        std::cout << "BC1 textures are not supported, color maps stay uncompressed" << std::endl;
+    }
+    std::vector<TextureStreamer::Request> requests;
+    qint64 load_ns = 0;
+    for (auto &[key, job]: jobs) {
+        job.resolution = m_terrain.selectResolution(footprints[key]);
+        job.cubemap = true;
+
+        GLuint color_map;
+        glGenTextures(1, &color_map);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, color_map);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        m_procedural_texture_map[key] = color_map;
+        m_procedural_jobs[key] = job;
+
+        if (settings.gpuTextures) {
+            m_baker.bake(job, color_map);
+            continue;
         }
+
+        QElapsedTimer load_timer;
+        load_timer.start();
+        bool cached = loadCachedColorMap(color_map, job);
+        load_ns += load_timer.nsecsElapsed();
+        if (!cached) {
+            auto preview_job = job;
+            preview_job.resolution = PREVIEW_RESOLUTION;
+            auto preview = m_terrain.generateTerrainColors(preview_job);
+            m_streamer.upload(color_map, true, preview_job.width(), preview_job.height(), preview.data());
+            requests.push_back(TextureStreamer::Request { color_map, job, persistent, colorMapKey(job), compressColorMaps() });
+        }
+    }
+
+    // Wait for the baking draws so that the timing covers them
+    if (settings.gpuTextures) glFinish();
+
+    if (settings.gpuTextures) {
+        std::cout << "Color maps: " << jobs.size() << " baked in " << timer.elapsed() << " ms" << std::endl;
+    } else {
+        std::cout << "Color maps: " << jobs.size() << " total, "
+                  << m_texture_cache.getHits() << " cache hits (" << load_ns / 1000000 << " ms to load), "
+                  << m_texture_cache.getMisses() << " cache misses, "
+                  << requests.size() << " previews, ready in " << timer.elapsed() << " ms" << std::endl;
     }
 
+    m_streamer.enqueue(&m_terrain, &m_texture_cache, std::move(requests));
+
     for (int i = 0; i < DEFAULT_TEXTURES.size(); ++i) {
         auto fpath = DEFAULT_TEXTURES[i];
         auto img = QImage(fpath.data()).convertToFormat(QImage::Format_RGBA8888).mirrored();
@@ -402,6 +507,14 @@ void Renderer::renderGeometry(GLuint shader) {
         glUniform1f(glGetUniformLocation(shader, (prefix + "angle").data()), m_data.lights[i].angle);
     }
 
+    // The cloud layer's keyframes stay bound for every shape, on the units after the cube map's
+    if (m_clouds.isActive()) {
+        m_clouds.bind(shader, 3);
+    }
+    if (m_virtual_texture.isActive()) {
+        m_virtual_texture.bind(shader, 5);
+    }
+
     for (auto &shape: m_data.shapes) {
         auto model = shape->ctm;
         auto primitive = shape->primitive;
@@ -429,28 +542,54 @@ void Renderer::renderGeometry(GLuint shader) {
         glUniform1f(glGetUniformLocation(shader, "material.repeatV"), primitive.material.textureMap.repeatV);
         glUniform1f(glGetUniformLocation(shader, "material.blend"), primitive.material.blend);
 
-        // Load texture if necessasry
+        // Load texture if necessasry, procedural color maps are cube maps on their own unit
+        bool uses_cube_map = false;
         if (shape->primitive.material.textureMap.isUsed) {
-            glActiveTexture(GL_TEXTURE0);
             if (!settings.procedural && !settings.proceduralTexture) {
+                glActiveTexture(GL_TEXTURE0);
                 glBindTexture(GL_TEXTURE_2D, m_default_texture_map[shape->type]);
             } else {
-                glBindTexture(GL_TEXTURE_2D, m_procedural_texture_map[shape->type]);
+                uses_cube_map = true;
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_CUBE_MAP, m_procedural_texture_map[shape->type]);
             }
         }
+        glUniform1i(glGetUniformLocation(shader, "use_cube_tex"), uses_cube_map);
+        glUniform1i(glGetUniformLocation(shader, "cube_tex"), 2);
+
+        // Clouds cover the planets with climates, over their procedural color maps
+        bool clouded = false;
+        if (uses_cube_map && m_clouds.isActive()) {
+            auto it = m_procedural_jobs.find(shape->type);
+            clouded = it != m_procedural_jobs.end() && it->second.biomes != nullptr;
+        }
+        glUniform1i(glGetUniformLocation(shader, "use_clouds"), clouded);
+        glUniform1i(glGetUniformLocation(shader, "use_virtual_tex"), uses_cube_map && m_virtual_texture.isActive()
+                    && settings.orbitCamera && shape == m_data.shapes[m_camera_at]);
+
+        // The displaced surface's normals already follow the heights the normal map would add
+        bool displaced = m_planet_terrain.isActive() && settings.orbitCamera && shape == m_data.shapes[m_camera_at];
 
         // Normal Mapping
         if (settings.normalMapping) {
             glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, m_normal_map);
-            glUniform1i(glGetUniformLocation(shader, "enable_normal_mapping"), settings.normalMapping);
+            glBindTexture(GL_TEXTURE_2D, m_normal_maps[shape->type]);
+            glUniform1i(glGetUniformLocation(shader, "enable_normal_mapping"), !displaced);
             glUniform1i(glGetUniformLocation(shader, "normal_map"), 1);
         }
 
         // Draw shape
-        glDrawArrays(GL_TRIANGLES, 0, mesh.size);
+        if (displaced) {
+            m_planet_terrain.draw();
+        } else {
+            glDrawArrays(GL_TRIANGLES, 0, mesh.size);
+        }
 
         // Unbind Everything
+        if (uses_cube_map) {
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        }
         glBindTexture(GL_TEXTURE_2D, 0);
         glBindVertexArray(0);
     }
@@ -497,7 +636,97 @@ void Renderer::renderFBO(GLuint shader) {
     glUseProgram(0);
 }
 
+// Regenerates the orbited body's color and normal maps at a higher tier once the camera has zoomed
+// in far enough to magnify them. Maps are never downgraded, so zooming back out costs nothing.
+void Renderer::refineTextures() {
+    if (!settings.orbitCamera || (!settings.procedural && !settings.proceduralTexture)) return;
+
+    auto *shape = m_data.shapes[m_camera_at];
+    auto it = m_procedural_jobs.find(shape->type);
+    if (it == m_procedural_jobs.end()) return;
+
+    auto &job = it->second;
+    int resolution = m_terrain.selectResolution(getScreenDiameter(shape));
+    if (resolution <= job.resolution) return;
+
+    job.resolution = resolution;
+    GLuint color_map = m_procedural_texture_map[shape->type];
+    if (settings.gpuTextures) {
+        m_baker.bake(job, color_map);
+    } else if (!loadCachedColorMap(color_map, job)) {
+        m_streamer.enqueue(&m_terrain, &m_texture_cache, {
+            TextureStreamer::Request { color_map, job, m_persistent_textures, colorMapKey(job), compressColorMaps() }
+        });
+    }
+    m_normal_streamer.enqueue(&m_terrain, &m_texture_cache, { normalMapRequest(m_normal_maps[shape->type], job) });
+}
+
+// Pages in the virtual texture of the orbited planet, if its color map is procedural and not
+// banded; bands have no detail past the map's resolution
+void Renderer::updateVirtualTexture() {
+    RenderShapeData *shape = settings.orbitCamera ? m_data.shapes[m_camera_at] : nullptr;
+    auto it = shape ? m_procedural_jobs.find(shape->type) : m_procedural_jobs.end();
+    if (it == m_procedural_jobs.end() || it->second.banded || !shape->primitive.material.textureMap.isUsed
+        || (!settings.procedural && !settings.proceduralTexture)) {
+        m_virtual_texture.stop();
+        m_virtual_type = -1;
+        return;
+    }
+
+    if (m_virtual_type != shape->type) {
+        m_virtual_texture.start(&m_terrain, it->second, compressColorMaps());
+        m_virtual_type = shape->type;
+    }
+
+    // The camera in the planet's object space, where a pixel spans the same angle, and the cone
+    // through the corners of the view frustum
+    auto to_object = glm::inverse(shape->ctm);
+    auto camera = glm::vec3(to_object * m_camera.getPosition());
+    auto look = glm::normalize(glm::vec3(to_object * glm::inverse(m_camera.getViewMatrix()) * glm::vec4(0, 0, -1, 0)));
+    float tan_half_height = glm::tan(m_camera.getHeightAngle() / 2);
+    float aspect = float(m_screen_width) / m_screen_height;
+    float cone = glm::atan(tan_half_height * glm::sqrt(1 + aspect * aspect));
+    m_virtual_texture.update(camera, look, cone, 2 * tan_half_height / m_screen_height);
+}
+
+// Refines the displaced surface of the orbited planet, if it is a sphere with a procedural, not
+// banded job; bands have no relief
+void Renderer::updatePlanetTerrain() {
+    RenderShapeData *shape = settings.orbitCamera && settings.displacedTerrain ? m_data.shapes[m_camera_at] : nullptr;
+    auto it = shape ? m_procedural_jobs.find(shape->type) : m_procedural_jobs.end();
+    if (it == m_procedural_jobs.end() || it->second.banded
+        || shape->primitive.type != PrimitiveType::PRIMITIVE_SPHERE) {
+        m_planet_terrain.stop();
+        m_terrain_type = -1;
+        return;
+    }
+
+    if (m_terrain_type != shape->type) {
+        m_planet_terrain.start(&m_terrain, it->second);
+        m_terrain_type = shape->type;
+    }
+
+    // The camera in the planet's object space, and the cone through the corners of the view frustum
+    auto to_object = glm::inverse(shape->ctm);
+    auto camera = glm::vec3(to_object * m_camera.getPosition());
+    auto look = glm::normalize(glm::vec3(to_object * glm::inverse(m_camera.getViewMatrix()) * glm::vec4(0, 0, -1, 0)));
+    float aspect = float(m_screen_width) / m_screen_height;
+    float cone = glm::atan(glm::tan(m_camera.getHeightAngle() / 2) * glm::sqrt(1 + aspect * aspect));
+    m_planet_terrain.update(camera, look, cone);
+}
+
 void Renderer::render(GLuint phong_shader, GLuint texture_shader) {
+    // Swap in any color and normal maps that finished generating since the last frame
+    m_streamer.update();
+    m_normal_streamer.update();
+    refineTextures();
+    updateVirtualTexture();
+    updatePlanetTerrain();
+    if (m_cloud_time > 0) {
+        m_clouds.update(m_cloud_time);
+        m_cloud_time = 0;
+    }
+
     // Render geometries to the FBO
     glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_data.fbo);
     renderGeometry(phong_shader);
@@ -518,6 +747,15 @@ void Renderer::clearGeometryData() {
 }
 
 void Renderer::clearTextureData() {
+    // Stop refining textures that are about to be deleted
+    m_streamer.stop();
+    m_normal_streamer.stop();
+    m_clouds.stop();
+    m_virtual_texture.stop();
+    m_virtual_type = -1;
+    m_planet_terrain.stop();
+    m_terrain_type = -1;
+
     // Recycle all textures
     for (auto &it: m_default_texture_map) {
         glDeleteTextures(1, &it.second);
@@ -527,8 +765,13 @@ void Renderer::clearTextureData() {
     }
 
     m_default_texture_map.clear();
+    for (auto &it: m_normal_maps) {
+        glDeleteTextures(1, &it.second);
+    }
+
     m_procedural_texture_map.clear();
-    glDeleteTextures(1, &m_normal_map);
+    m_procedural_jobs.clear();
+    m_normal_maps.clear();
 }
 
 void Renderer::clearSceneData() {
@@ -563,23 +806,39 @@ void Renderer::replaceCamera(int width, int height) {
     }
 }
 
-void Renderer::generateNormalMap() {
-    auto normal_map_file_path = std::string("resources/images/planet_normal.jpg");
-    auto image = QImage(normal_map_file_path.data()).convertToFormat(QImage::Format_RGBA8888).mirrored();
-//    auto& normal = m_terrain.generateTerrainNormals();
-//    auto resolution = m_terrain.getResolution();
-    glGenTextures(1, &m_normal_map);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, m_normal_map);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                 image.width(), image.height(), 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
-//    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-//                 resolution * 2, resolution, 0,
-//                 GL_RGBA, GL_FLOAT, normal.data());
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+// Gives every procedural job its normal map at the job's resolution tier. Persistent maps are
+// served from the disk cache when possible; the rest start from a preview-tier map and are
+// generated in the background, see NormalMapStreamer.
+void Renderer::generateNormalMaps() {
+    QElapsedTimer timer;
+    timer.start();
+    std::vector<NormalMapStreamer::Request> requests;
+    for (auto &[key, job]: m_procedural_jobs) {
+        GLuint normal_map;
+        glGenTextures(1, &normal_map);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, normal_map);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_normal_maps[key] = normal_map;
+        requests.push_back(normalMapRequest(normal_map, job));
+    }
+
+    // Every map shows a preview until its cached or generated map replaces it
+    for (auto &request: requests) {
+        auto preview_job = request.job;
+        preview_job.resolution = PREVIEW_RESOLUTION;
+        auto preview = m_terrain.generateTerrainNormals(preview_job);
+        m_normal_streamer.upload(request.texture, PREVIEW_RESOLUTION, preview.data());
+    }
+    int total = requests.size();
+    int hits = m_normal_streamer.enqueue(&m_terrain, &m_texture_cache, std::move(requests));
+
+    std::cout << "Normal maps: " << total << " total, " << hits << " cache hits, "
+              << total - hits << " queued, ready in " << timer.elapsed() << " ms" << std::endl;
 }
 
 static void insertVec3(std::vector<float> &data, glm::vec3 v) {
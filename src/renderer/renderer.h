@@ -11,6 +11,13 @@
 #include "planet/planetarysystem.h"
 #include <unordered_map>
 #include "utils/terraingenerator.h"
+#include "utils/texturecache.h"
+#include "renderer/texturestreamer.h"
+#include "renderer/normalmapstreamer.h"
+#include "renderer/texturebaker.h"
+#include "renderer/cloudlayer.h"
+#include "renderer/virtualtexture.h"
+#include "renderer/planetterrain.h"
 
 struct MeshData {
     GLuint vao;
@@ -34,6 +41,7 @@ public:
     void updateScene(int width, int height);
     void updateGeometry();
     void updatePlanets(float deltaTime);
+    void updateClouds(float deltaTime);
     void updateCamera(int width, int hieght);
     void moveCamera(std::unordered_map<Qt::Key, bool> &key_map, float dist);
     void rotateCamera(float dx, float dy);
@@ -74,8 +82,26 @@ private:
    std::unordered_map<int, GLuint> m_default_texture_map;
    std::unordered_map<int, GLuint> m_procedural_texture_map;
    void generateTextures();
+   void refineTextures();
+   float getScreenDiameter(RenderShapeData *shape) const;
+   bool loadCachedColorMap(GLuint texture, const TerrainJob &job);
+   bool compressColorMaps() const;
    int planet_type_count = 10;
    TerrainGenerator m_terrain;
+   TextureCache m_texture_cache;
+   TextureStreamer m_streamer;
+   TextureBaker m_baker;
+   VirtualTexture m_virtual_texture;                      // of the orbited planet, up close
+   int m_virtual_type = -1;                               // shape type the virtual texture is of
+   void updateVirtualTexture();
+   PlanetTerrain m_planet_terrain;                        // the orbited planet's displaced surface
+   int m_terrain_type = -1;                               // shape type the displaced surface is of
+   void updatePlanetTerrain();
+   CloudLayer m_clouds;                                   // shared by the planets whose jobs have biomes
+   float m_cloud_time = 0;                                // seconds the clouds have yet to advance
+   std::unordered_map<int, TerrainJob> m_procedural_jobs;  // job of every procedural texture, at its current tier
+   bool m_persistent_textures = false;
+   bool m_compressed_textures = false;                    // color maps end up as BC1, normal maps as BC5
 
    // Final Project
    PlanetarySystem m_ps;
@@ -84,7 +110,9 @@ private:
 
    GLuint m_planet_shader;
    GLuint m_line_shader;
-   GLuint m_normal_map;
-   void generateNormalMap();
+   std::unordered_map<int, GLuint> m_normal_maps;      // RG8 tangent-space normals of every procedural job
+   NormalMapStreamer m_normal_streamer;
+   void generateNormalMaps();
+   NormalMapStreamer::Request normalMapRequest(GLuint texture, const TerrainJob &job) const;
    std::vector<float> computeTangents(std::vector<float> &mesh);
 };
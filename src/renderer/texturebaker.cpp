@@ -0,0 +1,181 @@
+#include "renderer/texturebaker.h"
+#include "utils/shaderloader.h"
+
+TextureBaker::~TextureBaker() {
+    glDeleteFramebuffers(1, &m_fbo);
+    glDeleteProgram(m_shader);
+}
+
+void TextureBaker::initialize(GLuint quad_vao) {
+    m_quad_vao = quad_vao;
+    m_shader = ShaderLoader::createShaderProgram(
+                "resources/shaders/texture.vert",
+                "resources/shaders/terrain.frag"
+    );
+    glGenFramebuffers(1, &m_fbo);
+}
+
+// Uploads a one-row (or height-row) table into texture, fetched by index without filtering
+static void createRowTexture(GLuint texture, GLint internal_format, int width, GLenum format, GLenum type,
+                             const void *data, int height = 1) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void TextureBaker::bake(const TerrainJob &job, GLuint texture) {
+    int width = job.width();
+    int height = job.cubemap ? width : job.height();
+
+    // Remember the caller's target, the renderer's default framebuffer is not always 0
+    GLint prev_fbo;
+    GLint prev_viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_fbo);
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+
+    // The noise table as a one-row float texture, fetched by index without filtering
+    std::vector<float> gradients(job.noise.gradX.size() * 3);
+    for (size_t i = 0; i < job.noise.gradX.size(); ++i) {
+        gradients[3 * i] = job.noise.gradX[i];
+        gradients[3 * i + 1] = job.noise.gradY[i];
+        gradients[3 * i + 2] = job.noise.gradZ[i];
+    }
+
+    GLuint gradient_texture;
+    glGenTextures(1, &gradient_texture);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gradient_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F,
+                 job.noise.gradX.size(), 1, 0,
+                 GL_RGB, GL_FLOAT, gradients.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // The palette and band tables are the CPU's own, so the bake matches it up to float rounding
+    GLuint ramp_texture;
+    glGenTextures(1, &ramp_texture);
+    createRowTexture(ramp_texture, GL_RGBA8, PaletteRamp::SIZE, GL_RGBA, GL_UNSIGNED_BYTE, job.ramp->texels.data());
+
+    GLuint biome_texture = 0;
+    if (job.biomes != nullptr) {
+        glGenTextures(1, &biome_texture);
+        createRowTexture(biome_texture, GL_RGBA8, BiomeTable::SIZE, GL_RGBA, GL_UNSIGNED_BYTE,
+                         job.biomes->texels.data(), BiomeTable::SIZE);
+    }
+
+    GLuint band_textures[3] = {};
+    float band_scale = 0;
+    int band_pad = 0;
+    if (job.banded) {
+        BandSynthesizer bands(job.bands, job.palette, job.resolution, job.turbulence, job.noise);
+        band_scale = bands.scale();
+        band_pad = bands.pad();
+
+        std::vector<float> columns, rows;
+        for (size_t y = 0; y < bands.weights().size(); ++y) {
+            columns.insert(columns.end(), {bands.weights()[y], bands.wobble()[y]});
+        }
+        for (size_t x = 0; x < bands.peaks().size(); ++x) {
+            rows.insert(rows.end(), {bands.peaks()[x], bands.swirl()[x]});
+        }
+
+        glGenTextures(3, band_textures);
+        createRowTexture(band_textures[0], GL_RG32F, columns.size() / 2, GL_RG, GL_FLOAT, columns.data());
+        createRowTexture(band_textures[1], GL_RG32F, rows.size() / 2, GL_RG, GL_FLOAT, rows.data());
+        createRowTexture(band_textures[2], GL_RGBA8, bands.ramp().size() / 4, GL_RGBA, GL_UNSIGNED_BYTE, bands.ramp().data());
+    }
+
+    // Simplex 2:1 maps sample their rows on a cylinder, whose points take sin and cos
+    GLuint wrap_texture = 0;
+    auto octaves = job.octaves();
+    if (job.basis == NoiseBasis::SIMPLEX) {
+        int columns = job.resolution * 2;
+        std::vector<float> y(columns), z(columns), yz;
+        SimplexKernel::wrapColumns(octaves, 0, 1.f / job.resolution, columns, y.data(), z.data());
+        for (int i = 0; i < columns; ++i) yz.insert(yz.end(), {y[i], z[i]});
+        glGenTextures(1, &wrap_texture);
+        createRowTexture(wrap_texture, GL_RG32F, columns, GL_RG, GL_FLOAT, yz.data());
+    }
+
+    // Allocate the color map
+    GLenum target = job.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int faces = job.cubemap ? 6 : 1;
+    glBindTexture(target, texture);
+    for (int face = 0; face < faces; ++face) {
+        GLenum image = job.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        glTexImage2D(image, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(target, 0);
+
+    glUseProgram(m_shader);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, gradient_texture);
+    glUniform1i(glGetUniformLocation(m_shader, "gradients"), 0);
+    glUniform1i(glGetUniformLocation(m_shader, "mask"), NoiseTable::MASK);
+    glUniform1i(glGetUniformLocation(m_shader, "resolution"), job.resolution);
+    glUniform1i(glGetUniformLocation(m_shader, "banded"), job.banded);
+    glUniform1i(glGetUniformLocation(m_shader, "octave_count"), octaves.count);
+    glUniform1fv(glGetUniformLocation(m_shader, "octave_freq"), Octaves::MAX_COUNT, octaves.freq);
+    glUniform1fv(glGetUniformLocation(m_shader, "octave_amp"), Octaves::MAX_COUNT, octaves.amp);
+    glUniform1i(glGetUniformLocation(m_shader, "octave_wrap"), octaves.wrap);
+    glUniform1i(glGetUniformLocation(m_shader, "simplex"), job.basis == NoiseBasis::SIMPLEX);
+    glActiveTexture(GL_TEXTURE6);
+    glBindTexture(GL_TEXTURE_2D, wrap_texture);
+    glUniform1i(glGetUniformLocation(m_shader, "wrap_columns"), 6);
+    glActiveTexture(GL_TEXTURE4);
+    glBindTexture(GL_TEXTURE_2D, ramp_texture);
+    glUniform1i(glGetUniformLocation(m_shader, "palette_ramp"), 4);
+    glUniform1f(glGetUniformLocation(m_shader, "ramp_min"), PaletteRamp::MIN_HEIGHT);
+    glUniform1f(glGetUniformLocation(m_shader, "ramp_scale"), PaletteRamp::SCALE);
+    glActiveTexture(GL_TEXTURE5);
+    glBindTexture(GL_TEXTURE_2D, biome_texture);
+    glUniform1i(glGetUniformLocation(m_shader, "biome_table"), 5);
+    glUniform1i(glGetUniformLocation(m_shader, "biomes"), job.biomes != nullptr);
+    glUniform1i(glGetUniformLocation(m_shader, "biome_octaves"), TerrainGenerator::BIOME_OCTAVES);
+    glUniform1i(glGetUniformLocation(m_shader, "channel_offset"), NoiseTable::CHANNEL_OFFSET);
+    auto craters = job.craters();
+    glUniform1i(glGetUniformLocation(m_shader, "crater_count"), craters.count);
+    glUniform1fv(glGetUniformLocation(m_shader, "crater_freq"), Craters::MAX_SCALES, craters.freq);
+    glUniform1fv(glGetUniformLocation(m_shader, "crater_depth"), Craters::MAX_SCALES, craters.depth);
+    glUniform1f(glGetUniformLocation(m_shader, "crater_density"), craters.density);
+    glUniform1i(glGetUniformLocation(m_shader, "crater_channel"), NoiseTable::MAX_CHANNELS);
+    glUniform1i(glGetUniformLocation(m_shader, "sphere"), job.sampledOnSphere());
+    const char *band_samplers[3] = {"band_columns", "band_rows", "band_ramp"};
+    for (int i = 0; i < 3; ++i) {
+        glActiveTexture(GL_TEXTURE1 + i);
+        glBindTexture(GL_TEXTURE_2D, band_textures[i]);
+        glUniform1i(glGetUniformLocation(m_shader, band_samplers[i]), 1 + i);
+    }
+    glUniform1i(glGetUniformLocation(m_shader, "band_pad"), band_pad);
+    glUniform1f(glGetUniformLocation(m_shader, "band_scale"), band_scale);
+
+    // Render into each face, without a depth attachment every fragment passes the depth test
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, width, height);
+    glBindVertexArray(m_quad_vao);
+    for (int face = 0; face < faces; ++face) {
+        GLenum image = job.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, texture, 0);
+        glUniform1i(glGetUniformLocation(m_shader, "face"), job.cubemap ? face : -1);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+
+    // Unbind all and release the tables, the draws keep what they still need alive
+    glBindVertexArray(0);
+    for (int i = 6; i >= 0; --i) {
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    glUseProgram(0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_fbo);
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glDeleteTextures(1, &gradient_texture);
+    glDeleteTextures(1, &ramp_texture);
+    if (biome_texture != 0) glDeleteTextures(1, &biome_texture);
+    if (wrap_texture != 0) glDeleteTextures(1, &wrap_texture);
+    glDeleteTextures(3, band_textures);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+
+// Renders color maps on the GPU instead of generating them with TerrainGenerator. The fragment
+// shader evaluates the same noise table and palette for every texel of an FBO that has the target
+// texture attached, so the result matches the CPU map up to float rounding. Only needs a GL 3.3
+// context, so it also runs on software rasterizers such as Mesa's llvmpipe.
+class TextureBaker {
+public:
+    ~TextureBaker();
+
+    // Loads the baking shader; quad_vao is a fullscreen quad with position and uv attributes
+    void initialize(GLuint quad_vao);
+
+    // (Re)allocates texture as the job's RGBA8 color map and renders it, face by face for a cube
+    // map. Restores the framebuffer and viewport that were bound before.
+    void bake(const TerrainJob &job, GLuint texture);
+
+private:
+    GLuint m_shader = 0;
+    GLuint m_quad_vao = 0;
+    GLuint m_fbo = 0;
+};
@@ -0,0 +1,400 @@
+#include "renderer/texturestreamer.h"
+#include "utils/blockcompressor.h"
+
+#include <QElapsedTimer>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+// Bytes of a tile buffer, which fits the largest tile
+static const int TILE_BYTES = TerrainGenerator::TILE_SIZE * TerrainGenerator::TILE_SIZE * 4;
+
+TextureStreamer::~TextureStreamer() {
+    // Queued tiles are dropped, running ones finish into buffers nobody will read
+    m_cancel = true;
+    m_pool.reset();
+}
+
+// Specifies the texture's image from client memory, or from offsets into the bound pixel buffer
+// when texels is 0
+static void texImage(GLuint texture, bool cubemap, int width, int height, std::uintptr_t texels) {
+    glActiveTexture(GL_TEXTURE0);
+    if (cubemap) {
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int face = 0; face < 6; ++face) {
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGBA8,
+                         width, width, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, texels ? reinterpret_cast<void *>(texels + face * width * width * 4) : nullptr);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8,
+                     width, height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void *>(texels));
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+// Specifies the texture's image from BC1 blocks, laid out as BlockCompressor encodes them
+static void compressedTexImage(GLuint texture, bool cubemap, int width, int height, const std::uint8_t *blocks) {
+    glActiveTexture(GL_TEXTURE0);
+    if (cubemap) {
+        std::size_t face_bytes = BlockCompressor::bc1Size(width, width);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+        for (int face = 0; face < 6; ++face) {
+            glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                   width, width, 0, face_bytes, blocks + face * face_bytes);
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                               width, height, 0, BlockCompressor::bc1Size(width, height), blocks);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+}
+
+// Replaces a tile of the texture, whose cube faces are stacked as rows as in TerrainJob
+static void texSubImage(GLuint texture, bool cubemap, int width, const TerrainTile &tile, std::uintptr_t texels) {
+    GLenum target = cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    GLenum image = cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + tile.row / width : GL_TEXTURE_2D;
+    int row = cubemap ? tile.row % width : tile.row;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(target, texture);
+    glTexSubImage2D(image, 0, tile.col, row, tile.width, tile.height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, reinterpret_cast<void *>(texels));
+    glBindTexture(target, 0);
+}
+
+void TextureStreamer::upload(GLuint texture, bool cubemap, int width, int height, const void *texels,
+                             bool compressed) {
+    if (compressed) {
+        std::vector<std::uint8_t> blocks(BlockCompressor::bc1Size(width, height));
+        BlockCompressor::encodeBC1(static_cast<const std::uint8_t *>(texels), width, height, blocks.data());
+        compressedTexImage(texture, cubemap, width, height, blocks.data());
+        m_compressed.insert(texture);
+    } else {
+        texImage(texture, cubemap, width, height, reinterpret_cast<std::uintptr_t>(texels));
+        m_compressed.erase(texture);
+    }
+    m_heights[texture] = height;
+}
+
+void TextureStreamer::enqueue(const TerrainGenerator *terrain, TextureCache *cache, std::vector<Request> requests) {
+    if (requests.empty()) return;
+
+    m_terrain = terrain;
+    m_cache = cache;
+    if (m_pending.empty() && m_maps.empty() && m_staged == 0) {
+        m_timer.start();
+        m_streamed = 0;
+    }
+    for (auto &request: requests) m_pending.push_back(std::move(request));
+
+    if (m_pool == nullptr) m_pool = std::make_unique<WorkStealingPool>();
+}
+
+void TextureStreamer::stop() {
+    if (m_pool != nullptr) {
+        m_cancel = true;
+        m_pool->wait();
+        m_cancel = false;
+    }
+
+    // Every tile handed out is back among the results now
+    for (auto &tile: m_results) release(tile);
+    m_results.clear();
+    m_maps.clear();
+    m_pending.clear();
+    m_staged = 0;
+
+    // Deleting a buffer mid-transfer is safe, GL keeps it alive until the copy is done
+    for (auto &upload: m_uploads) {
+        glDeleteSync(upload.fence);
+        glDeleteBuffers(1, &upload.pbo);
+    }
+    m_uploads.clear();
+    glDeleteBuffers(m_free_pbos.size(), m_free_pbos.data());
+    m_free_pbos.clear();
+    m_heights.clear();
+    m_compressed.clear();
+}
+
+std::shared_ptr<TextureStreamer::Map> TextureStreamer::start(Request request) {
+    auto map = std::make_shared<Map>();
+    auto &job = request.job;
+    map->tiles = m_terrain->createTiles(job);
+    map->remaining = map->tiles.size();
+    if (job.banded) map->bands = std::make_unique<BandSynthesizer>(m_terrain->createBands(job));
+    if (request.compressed) map->blocks.resize(BlockCompressor::bc1Size(job.width(), job.height()));
+
+    // Persisted maps are generated into their cache file, and uploaded from its mapping
+    if (request.persistent) {
+        map->entry = m_cache->create(request.key, qint64(job.width()) * job.height() * 4);
+    }
+    map->request = std::move(request);
+    return map;
+}
+
+void TextureStreamer::stage(const std::shared_ptr<Map> &map) {
+    Tile tile;
+    tile.map = map;
+    tile.tile = map->tiles[map->next_tile++];
+
+    // The buffer stays mapped while a worker fills it, GL only needs it again for the upload
+    if (m_free_pbos.empty()) {
+        GLuint pbo;
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, TILE_BYTES, nullptr, GL_STREAM_DRAW);
+        m_free_pbos.push_back(pbo);
+    }
+    tile.pbo = m_free_pbos.back();
+    m_free_pbos.pop_back();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tile.pbo);
+    tile.texels = static_cast<std::uint8_t *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, TILE_BYTES,
+                                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    tile.stride = tile.tile.width * 4;
+
+    if (map->entry != nullptr) {
+        int width = map->request.job.width();
+        tile.cached = static_cast<std::uint8_t *>(map->entry->data()) + (std::size_t(tile.tile.row) * width + tile.tile.col) * 4;
+    }
+
+    m_staged += 1;
+    m_pool->submit([this, tile]() mutable {
+        auto &map = *tile.map;
+        if (!m_cancel) {
+            // Texels that are read again, to be encoded, are generated into ordinary memory and
+            // copied into the buffer, since reading back a mapped buffer can be slow. A persisted
+            // map's texels are generated into its cache entry.
+            auto &job = map.request.job;
+            int width = tile.tile.width, height = tile.tile.height;
+            std::vector<std::uint8_t> copy;
+            std::uint8_t *texels = tile.texels;
+            std::size_t stride = tile.stride;
+            if (tile.cached != nullptr) {
+                texels = tile.cached;
+                stride = std::size_t(job.width()) * 4;
+            } else if (!map.blocks.empty()) {
+                copy.resize(std::size_t(width) * height * 4);
+                texels = copy.data();
+            }
+            m_terrain->generateColorTile(job, map.bands.get(), tile.tile, texels, stride);
+            if (texels != tile.texels) {
+                for (int row = 0; row < height; ++row) {
+                    std::memcpy(tile.texels + row * tile.stride, texels + row * stride, width * 4);
+                }
+            }
+
+            // Tiles are whole blocks, since faces and tiles are multiples of 4 texels
+            if (!map.blocks.empty()) {
+                std::size_t block_stride = BlockCompressor::bc1Size(job.width(), 4);
+                auto *blocks = map.blocks.data() + tile.tile.row / 4 * block_stride
+                             + tile.tile.col / 4 * BlockCompressor::BC1_BLOCK_BYTES;
+                BlockCompressor::encodeBC1Blocks(texels, stride, width, height, blocks, block_stride);
+            }
+        }
+
+        // Handed back even if cancelled, only the GL thread can release the buffer
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(tile));
+    });
+}
+
+void TextureStreamer::release(Tile &tile) {
+    if (tile.pbo != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tile.pbo);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        m_free_pbos.push_back(tile.pbo);
+        tile.pbo = 0;
+    }
+}
+
+void TextureStreamer::finish(Map &map) {
+    // A stale map's cache entry may be incomplete, it is discarded with the map
+    if (map.stale) return;
+    if (map.entry != nullptr) map.entry->commit();
+    m_streamed += 1;
+
+    // Every tile has been uploaded uncompressed by now, the blocks replace them all at once
+    if (!map.blocks.empty()) {
+        auto &job = map.request.job;
+        compressedTexImage(map.request.texture, job.cubemap, job.width(), job.height(), map.blocks.data());
+        m_compressed.insert(map.request.texture);
+        m_streamed_bytes += std::size_t(job.width()) * job.height() * 4;
+        m_compressed_bytes += map.blocks.size();
+        map.blocks = {};
+    }
+}
+
+// Respecifies a BC1 texture as RGBA8 from its decoded blocks, so that it can be blitted
+void TextureStreamer::decompress(GLuint texture, bool cubemap, int width, int height) {
+    GLenum target = cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int faces = cubemap ? 6 : 1;
+    int face_height = height / faces;
+    std::size_t face_bytes = BlockCompressor::bc1Size(width, face_height);
+    std::vector<std::uint8_t> blocks(face_bytes * faces), texels(std::size_t(width) * height * 4);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(target, texture);
+    for (int face = 0; face < faces; ++face) {
+        GLenum image = cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        glGetCompressedTexImage(image, 0, blocks.data() + face * face_bytes);
+    }
+    glBindTexture(target, 0);
+
+    BlockCompressor::decodeBC1(blocks.data(), width, height, texels.data());
+    texImage(texture, cubemap, width, height, reinterpret_cast<std::uintptr_t>(texels.data()));
+    m_compressed.erase(texture);
+}
+
+void TextureStreamer::grow(const Map &map) {
+    auto &job = map.request.job;
+    GLuint texture = map.request.texture;
+    GLenum target = job.cubemap ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    int faces = job.cubemap ? 6 : 1;
+
+    // Current face size of the texture, from the height it was last uploaded at
+    int old_height = m_heights.count(texture) ? m_heights[texture] : 0;
+    int old_w = job.cubemap ? old_height / 6 : old_height * 2;
+    int old_h = job.cubemap ? old_height / 6 : old_height;
+    int new_w = job.width();
+    int new_h = job.cubemap ? job.width() : job.height();
+
+    if (old_height == 0) {
+        texImage(texture, job.cubemap, job.width(), job.height(), 0);
+        m_compressed.erase(texture);
+        return;
+    }
+    if (m_compressed.count(texture)) decompress(texture, job.cubemap, old_w, old_height);
+
+    // Copy the current image aside, reallocate the texture at the new size and stretch the copy
+    // back into it, so tiles land on an upscaled preview rather than on undefined texels
+    GLint prev_read, prev_draw;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev_read);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &prev_draw);
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+    glDisable(GL_SCISSOR_TEST);
+    if (m_fbos[0] == 0) glGenFramebuffers(2, m_fbos);
+
+    GLuint copy;
+    glGenTextures(1, &copy);
+    glBindTexture(target, copy);
+    for (int face = 0; face < faces; ++face) {
+        GLenum image = job.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+        glTexImage2D(image, 0, GL_RGBA8, old_w, old_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(target, 0);
+
+    auto blit = [&](GLuint from, GLuint to, int from_w, int from_h, int to_w, int to_h) {
+        for (int face = 0; face < faces; ++face) {
+            GLenum image = job.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbos[0]);
+            glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, from, 0);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbos[1]);
+            glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, image, to, 0);
+            glBlitFramebuffer(0, 0, from_w, from_h, 0, 0, to_w, to_h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        }
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    };
+
+    blit(texture, copy, old_w, old_h, old_w, old_h);
+    texImage(texture, job.cubemap, job.width(), job.height(), 0);
+    blit(copy, texture, old_w, old_h, new_w, new_h);
+    glDeleteTextures(1, &copy);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prev_read);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, prev_draw);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+}
+
+void TextureStreamer::update() {
+    // Recycle the buffers whose transfers have completed, without blocking on the others
+    for (auto it = m_uploads.begin(); it != m_uploads.end();) {
+        GLenum status = glClientWaitSync(it->fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            glDeleteSync(it->fence);
+            m_free_pbos.push_back(it->pbo);
+            it = m_uploads.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Keep the workers supplied, oldest map first. Requests that a sharper upload has made
+    // redundant are skipped before any of their tiles are generated.
+    while (m_staged < MAX_STAGED) {
+        if (m_maps.empty()) {
+            if (m_pending.empty()) break;
+            auto request = std::move(m_pending.front());
+            m_pending.pop_front();
+            if (m_heights[request.texture] >= request.job.height()) continue;
+            m_maps.push_back(start(std::move(request)));
+        }
+
+        auto map = m_maps.front();
+        if (map->stale) {
+            map->remaining -= map->tiles.size() - map->next_tile;
+            map->next_tile = map->tiles.size();
+            if (map->remaining == 0) finish(*map);
+        } else {
+            stage(map);
+        }
+        if (map->next_tile == map->tiles.size()) m_maps.pop_front();
+    }
+
+    for (int i = 0; i < MAX_UPLOADS_PER_FRAME; ++i) {
+        Tile tile;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_results.empty()) break;
+            tile = std::move(m_results.front());
+            m_results.pop_front();
+        }
+        m_staged -= 1;
+
+        // The first tile resizes the texture, unless a sharper version of it has been uploaded
+        // meanwhile; a map that has lost the texture to a sharper one drops its remaining tiles
+        auto &map = *tile.map;
+        auto &job = map.request.job;
+        int &height = m_heights[map.request.texture];
+        if (!map.grown && height < job.height()) {
+            grow(map);
+            height = job.height();
+            map.grown = true;
+        }
+        if (height != job.height()) map.stale = true;
+
+        if (map.stale) {
+            release(tile);
+        } else {
+            // The texture sources the buffer asynchronously, it is recycled once the fence signals
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, tile.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            texSubImage(map.request.texture, job.cubemap, job.width(), tile.tile, 0);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            m_uploads.push_back(Upload { tile.pbo, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+        }
+
+        map.remaining -= 1;
+        if (map.remaining == 0) finish(map);
+    }
+
+    if (m_streamed > 0 && m_pending.empty() && m_maps.empty() && m_staged == 0) {
+        std::cout << "Streamed " << m_streamed << " color maps in " << m_timer.elapsed() << " ms";
+        if (m_compressed_bytes > 0) {
+            std::cout << ", BC1 saved " << (m_streamed_bytes - m_compressed_bytes) / 1024 << " of "
+                      << m_streamed_bytes / 1024 << " KiB";
+        }
+        std::cout << std::endl;
+        m_streamed = 0;
+        m_streamed_bytes = 0;
+        m_compressed_bytes = 0;
+    }
+}
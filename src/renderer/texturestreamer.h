@@ -0,0 +1,130 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+#include "utils/texturecache.h"
+#include "utils/workstealingpool.h"
+
+#include <QElapsedTimer>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Generates full-resolution color maps in the background and refines textures that already hold a
+// cheap preview. Maps are split into tiles, and the tiles of all outstanding maps are spread over a
+// work-stealing pool, so a single large map keeps every core busy. Texels are generated straight
+// into the memory they are uploaded from, a mapped per-tile pixel buffer object; tiles of maps that
+// are persisted are generated into the mapped cache file and copied into their buffer. A finished
+// tile is uploaded with glTexSubImage2D on the next frame, over an upscaled copy of the preview,
+// and each buffer is only reused once its fence has signaled, so the GL thread never waits on
+// generation or on a synchronous transfer.
+//
+// Compressed maps are streamed the same way, and their tiles are also encoded to BC1 as they are
+// generated. Once a map's last tile is in, the texture is respecified from its blocks with
+// glCompressedTexImage2D, at an eighth of its RGBA8 size. Compressed textures can't be blitted,
+// so a compressed texture that grows is first read back and respecified uncompressed.
+class TextureStreamer {
+public:
+    struct Request {
+        GLuint texture;             // texture to refine in place
+        TerrainJob job;             // full-resolution job
+        bool persistent;            // store the generated map in the cache
+        TextureCache::Key key;
+        bool compressed = false;    // end up as BC1, see BlockCompressor
+    };
+
+    ~TextureStreamer();
+
+    // Uploads texels into the texture right away, e.g. a preview or a cached map. Results of
+    // earlier requests at a lower resolution will no longer replace it. A cube map's texels hold
+    // its six width x width faces one after another, height is then 6 * width. Compressed
+    // uploads are encoded to BC1 first, on all cores.
+    void upload(GLuint texture, bool cubemap, int width, int height, const void *texels, bool compressed = false);
+
+    // Queues requests behind the outstanding ones, starting the workers if needed. GL thread only.
+    void enqueue(const TerrainGenerator *terrain, TextureCache *cache, std::vector<Request> requests);
+
+    // Cancels outstanding work and waits for the workers to go idle. GL thread only, since it also
+    // releases the pixel buffers that are still mapped or in flight.
+    void stop();
+
+    // GL thread, once per frame: releases completed transfers, maps the destinations of the next
+    // tiles for the workers, and uploads at most MAX_UPLOADS_PER_FRAME finished tiles
+    void update();
+
+private:
+    // A request whose tiles are being generated
+    struct Map {
+        Request request;
+        std::vector<TerrainTile> tiles;
+        std::size_t next_tile = 0;                  // next tile to stage
+        int remaining = 0;                          // tiles not yet uploaded or dropped
+        std::unique_ptr<BandSynthesizer> bands;     // shared by the tiles of a banded map
+        std::unique_ptr<TextureCache::Entry> entry; // destination of a persisted map
+        std::vector<std::uint8_t> blocks;           // BC1 blocks of a compressed map, by tile
+        bool grown = false;                         // the texture has been resized for it
+        bool stale = false;                         // superseded, its remaining tiles are dropped
+    };
+
+    // A tile with the mapped pixel buffer it is uploaded from, and its place in the map's cache
+    // entry if the map is persisted
+    struct Tile {
+        std::shared_ptr<Map> map;
+        TerrainTile tile;
+        GLuint pbo = 0;
+        std::uint8_t *texels = nullptr;
+        std::size_t stride = 0;
+        std::uint8_t *cached = nullptr;     // rows span the whole map
+    };
+
+    struct Upload {
+        GLuint pbo;
+        GLsync fence;
+    };
+
+    std::shared_ptr<Map> start(Request request);
+    void stage(const std::shared_ptr<Map> &map);
+    void release(Tile &tile);
+    void finish(Map &map);
+    void grow(const Map &map);
+    void decompress(GLuint texture, bool cubemap, int width, int height);
+
+    const TerrainGenerator *m_terrain = nullptr;
+    TextureCache *m_cache = nullptr;
+
+    std::unique_ptr<WorkStealingPool> m_pool;
+    std::atomic<bool> m_cancel = false;
+
+    std::mutex m_mutex;
+    std::deque<Tile> m_results;             // guarded by m_mutex
+
+    // GL thread only
+    std::deque<Request> m_pending;
+    std::deque<std::shared_ptr<Map>> m_maps;    // maps with tiles left to stage, oldest first
+    int m_staged = 0;                       // tiles handed to the pool but not yet uploaded
+    std::vector<GLuint> m_free_pbos;        // tile buffers whose transfers have completed
+    std::vector<Upload> m_uploads;
+    std::unordered_map<GLuint, int> m_heights;  // current height of every texture we uploaded
+    std::unordered_set<GLuint> m_compressed;    // textures whose image is BC1
+    GLuint m_fbos[2] = {};                  // read and draw framebuffers for grow()
+    QElapsedTimer m_timer;                  // since the queue last became busy
+    int m_streamed = 0;
+    std::size_t m_streamed_bytes = 0;       // RGBA8 size of the compressed maps streamed
+    std::size_t m_compressed_bytes = 0;     // and of their blocks
+
+    // Enough to upload a few 512 maps' worth of tiles per second at 60 frames per second
+    inline static const int MAX_UPLOADS_PER_FRAME = 32;
+
+    // Tiles mapped ahead of the workers, enough to keep them busy between two frames
+    inline static const int MAX_STAGED = 128;
+};
@@ -0,0 +1,286 @@
+#include "renderer/virtualtexture.h"
+#include "utils/blockcompressor.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Pages the camera may need at once, leaving a quarter of the atlas for pages it just turned away
+// from, which are evicted last
+static const int MAX_NEEDED = VirtualTexture::ATLAS_SLOTS * VirtualTexture::ATLAS_SLOTS * 3 / 4;
+
+VirtualTexture::Page VirtualTexture::Page::fromKey(int key) {
+    Page page;
+    page.col = key % PAGES_PER_FACE;
+    key /= PAGES_PER_FACE;
+    page.row = key % PAGES_PER_FACE;
+    key /= PAGES_PER_FACE;
+    page.face = key % 6;
+    page.level = key / 6;
+    return page;
+}
+
+VirtualTexture::~VirtualTexture() {
+    // Queued pages are dropped, running ones finish into results nobody will upload
+    m_pool.reset();
+}
+
+void VirtualTexture::start(const TerrainGenerator *terrain, const TerrainJob &job, bool compressed) {
+    stop();
+
+    m_terrain = terrain;
+    m_job = job;
+    m_compressed = compressed;
+    m_slots.assign(ATLAS_SLOTS * ATLAS_SLOTS, Slot());
+    m_frame = 0;
+
+    glActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &m_atlas);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    int atlas_texels = ATLAS_SLOTS * SLOT_TEXELS;
+    if (m_compressed) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, atlas_texels, atlas_texels, 0,
+                               BlockCompressor::bc1Size(atlas_texels, atlas_texels), nullptr);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas_texels, atlas_texels, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+
+    // Level l of the page table holds the six faces' (PAGES_PER_FACE >> l)^2 entries side by side,
+    // which is the mip chain of level 0. Entries are integers and fetched, never filtered.
+    glGenTextures(1, &m_page_table);
+    glBindTexture(GL_TEXTURE_2D, m_page_table);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, LEVELS - 1);
+    for (int level = 0; level < LEVELS; ++level) {
+        int pages = PAGES_PER_FACE >> level;
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8UI, 6 * pages, pages, 0,
+                     GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Every direction needs a page to fall back on before the first frame
+    m_pool = std::make_unique<WorkStealingPool>();
+    for (int face = 0; face < 6; ++face) {
+        request(Page { LEVELS - 1, face, 0, 0 });
+    }
+    m_pool->wait();
+    uploadResults(6);
+    updatePageTable();
+}
+
+void VirtualTexture::stop() {
+    // Waits for the running pages, queued ones are dropped
+    m_pool.reset();
+    m_results.clear();
+    m_in_flight.clear();
+    m_resident.clear();
+    m_slots.clear();
+
+    if (isActive()) {
+        glDeleteTextures(1, &m_atlas);
+        glDeleteTextures(1, &m_page_table);
+        m_atlas = 0;
+        m_page_table = 0;
+    }
+}
+
+void VirtualTexture::request(const Page &page) {
+    m_in_flight.insert(page.key());
+    m_pool->submit([this, page]() {
+        // The slot's border is the texels just past the page, on the page's level
+        int border = (SLOT_TEXELS - PAGE_TEXELS) / 2;
+        int face_size = PAGE_TEXELS * (PAGES_PER_FACE >> page.level);
+        Result result { page.key(), std::vector<std::uint8_t>(SLOT_TEXELS * SLOT_TEXELS * 4) };
+        m_terrain->generateCubePage(m_job, face_size, page.face, page.row * PAGE_TEXELS - border,
+                                    page.col * PAGE_TEXELS - border, SLOT_TEXELS, result.texels.data());
+        if (m_compressed) {
+            // Slots are whole blocks, so a page's blocks never mix texels of its neighbours
+            std::vector<std::uint8_t> blocks(BlockCompressor::bc1Size(SLOT_TEXELS, SLOT_TEXELS));
+            BlockCompressor::encodeBC1Blocks(result.texels.data(), SLOT_TEXELS * 4, SLOT_TEXELS, SLOT_TEXELS,
+                                             blocks.data(), BlockCompressor::bc1Size(SLOT_TEXELS, 4));
+            result.texels = std::move(blocks);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back(std::move(result));
+    });
+}
+
+int VirtualTexture::allocateSlot() {
+    // A free slot, or else the least recently needed page that is neither needed this frame nor
+    // one of the coarsest
+    int best = -1;
+    for (int i = 0; i < int(m_slots.size()); ++i) {
+        auto &slot = m_slots[i];
+        if (slot.key < 0) return i;
+        if (slot.used == m_frame || Page::fromKey(slot.key).level == LEVELS - 1) continue;
+        if (best < 0 || slot.used < m_slots[best].used) best = i;
+    }
+    if (best >= 0) {
+        m_resident.erase(m_slots[best].key);
+        m_slots[best].key = -1;
+    }
+    return best;
+}
+
+void VirtualTexture::uploadResults(int max) {
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int count = std::min(max, int(m_results.size()));
+        std::move(m_results.begin(), m_results.begin() + count, std::back_inserter(results));
+        m_results.erase(m_results.begin(), m_results.begin() + count);
+    }
+
+    for (auto &result: results) {
+        m_in_flight.erase(result.key);
+        int slot = allocateSlot();
+        if (slot < 0) continue;
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_atlas);
+        int x = slot % ATLAS_SLOTS * SLOT_TEXELS, y = slot / ATLAS_SLOTS * SLOT_TEXELS;
+        if (m_compressed) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, SLOT_TEXELS, SLOT_TEXELS, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                      result.texels.size(), result.texels.data());
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, SLOT_TEXELS, SLOT_TEXELS, GL_RGBA, GL_UNSIGNED_BYTE,
+                            result.texels.data());
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        m_slots[slot] = Slot { result.key, m_frame };
+        m_resident[result.key] = slot;
+        m_table_dirty = true;
+    }
+}
+
+void VirtualTexture::update(glm::vec3 camera, glm::vec3 look, float coneAngle, float pixelAngle) {
+    if (!isActive()) return;
+    ++m_frame;
+
+    // Pages on the near side of the horizon and inside the view cone, from the six coarsest
+    // down. The page whose texels are the most magnified, where it is nearest the camera, is
+    // refined first, until every page's texels are no larger than a pixel or the atlas is spoken
+    // for. Pages are bounded by the cap around their center direction through their farthest
+    // corner, and by the sphere around its center through that corner.
+    float distance = std::max(glm::length(camera), 0.5f);
+    auto view = glm::normalize(camera);
+    float horizon = std::acos(0.5f / distance);
+    std::vector<std::pair<float, Page>> queue;     // heap of visible pages by texels per pixel
+    auto byMagnification = [](const auto &a, const auto &b) { return a.first < b.first; };
+    auto consider = [&](const Page &page) {
+        float step = 2.f / (PAGES_PER_FACE >> page.level);
+        float sc = -1 + page.col * step;
+        float tc = -1 + page.row * step;
+        auto center = glm::normalize(TerrainGenerator::getCubeDirection(page.face, sc + step / 2, tc + step / 2));
+        float cos_radius = 1;
+        for (int corner = 0; corner < 4; ++corner) {
+            auto dir = TerrainGenerator::getCubeDirection(page.face, sc + step * (corner & 1), tc + step * (corner >> 1));
+            cos_radius = std::min(cos_radius, glm::dot(center, glm::normalize(dir)));
+        }
+        float radius = std::acos(cos_radius);
+        float angle = std::acos(std::clamp(glm::dot(center, view), -1.f, 1.f));
+        float nearest_angle = std::max(angle - radius, 0.f);
+        if (nearest_angle > horizon) return;
+
+        auto offset = 0.5f * center - camera;
+        float chord = std::sin(radius / 2);
+        float length = glm::length(offset);
+        if (length > chord) {
+            float off_axis = std::acos(std::clamp(glm::dot(offset / length, look), -1.f, 1.f));
+            if (off_axis - std::asin(chord / length) > coneAngle) return;
+        }
+
+        // Face texels are about 1 / face size across at radius 0.5
+        float nearest = std::sqrt(distance * distance + 0.25f - distance * std::cos(nearest_angle));
+        int face_size = PAGE_TEXELS * (PAGES_PER_FACE >> page.level);
+        queue.emplace_back(1 / (face_size * nearest * pixelAngle), page);
+        std::push_heap(queue.begin(), queue.end(), byMagnification);
+    };
+
+    for (int face = 0; face < 6; ++face) {
+        consider(Page { LEVELS - 1, face, 0, 0 });
+    }
+    std::vector<Page> needed;
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), byMagnification);
+        auto [magnification, page] = queue.back();
+        queue.pop_back();
+
+        needed.push_back(page);
+        if (page.level == 0 || magnification <= 1 || int(needed.size() + queue.size()) + 4 > MAX_NEEDED) continue;
+        for (int child = 0; child < 4; ++child) {
+            consider(Page { page.level - 1, page.face, page.row * 2 + (child >> 1), page.col * 2 + (child & 1) });
+        }
+    }
+
+    // Keep the needed pages, and generate the missing ones in the order they were selected, so
+    // parents come before their children
+    for (auto &page: needed) {
+        int key = page.key();
+        auto it = m_resident.find(key);
+        if (it != m_resident.end()) {
+            m_slots[it->second].used = m_frame;
+        } else if (!m_in_flight.count(key) && int(m_in_flight.size()) < MAX_IN_FLIGHT) {
+            request(page);
+        }
+    }
+
+    uploadResults(MAX_UPLOADS_PER_FRAME);
+    if (m_table_dirty) updatePageTable();
+}
+
+void VirtualTexture::updatePageTable() {
+    // Every entry points at its own page if resident, else at its parent's entry, which has
+    // already been filled in since the levels go from coarsest to finest
+    std::vector<std::uint8_t> coarser;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_page_table);
+    for (int level = LEVELS - 1; level >= 0; --level) {
+        int pages = PAGES_PER_FACE >> level;
+        std::vector<std::uint8_t> entries(6 * pages * pages * 4, 0);
+        for (int face = 0; face < 6; ++face) {
+            for (int row = 0; row < pages; ++row) {
+                for (int col = 0; col < pages; ++col) {
+                    std::uint8_t *entry = &entries[(row * 6 * pages + face * pages + col) * 4];
+                    auto it = m_resident.find(Page { level, face, row, col }.key());
+                    if (it != m_resident.end()) {
+                        entry[0] = it->second % ATLAS_SLOTS;
+                        entry[1] = it->second / ATLAS_SLOTS;
+                        entry[2] = level;
+                        entry[3] = 1;
+                    } else if (level < LEVELS - 1) {
+                        int parent = (row / 2 * 3 * pages + face * pages / 2 + col / 2) * 4;
+                        std::copy_n(&coarser[parent], 4, entry);
+                    }
+                }
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, 6 * pages, pages,
+                        GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries.data());
+        coarser = std::move(entries);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_table_dirty = false;
+}
+
+void VirtualTexture::bind(GLuint shader, int unit) const {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glActiveTexture(GL_TEXTURE0 + unit + 1);
+    glBindTexture(GL_TEXTURE_2D, m_page_table);
+
+    glUniform1i(glGetUniformLocation(shader, "vt_atlas"), unit);
+    glUniform1i(glGetUniformLocation(shader, "vt_pages"), unit + 1);
+    glUniform1i(glGetUniformLocation(shader, "vt_levels"), LEVELS);
+    glUniform1i(glGetUniformLocation(shader, "vt_pages_per_face"), PAGES_PER_FACE);
+    glUniform1f(glGetUniformLocation(shader, "vt_page_texels"), PAGE_TEXELS);
+    glUniform1f(glGetUniformLocation(shader, "vt_slot_texels"), SLOT_TEXELS);
+    glUniform1f(glGetUniformLocation(shader, "vt_atlas_texels"), ATLAS_SLOTS * SLOT_TEXELS);
+}
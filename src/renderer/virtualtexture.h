@@ -0,0 +1,112 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+
+#include "utils/terraingenerator.h"
+#include "utils/workstealingpool.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A sparse virtual color map for the planet the camera is closest to. Each face of the planet's
+// cube map is a quadtree of pages over LEVELS levels, from one page per face up to PAGES_PER_FACE
+// x PAGES_PER_FACE pages, far more texels than any whole map could have. Every frame, the pages
+// that face the camera are refined until their texels are no larger than a pixel, and the missing
+// ones are generated in the background, coarsest first. Finished pages are uploaded into a fixed
+// atlas of ATLAS_SLOTS x ATLAS_SLOTS slots, evicting the least recently needed page once it is
+// full. A page table with an entry per page of every level points the shader at the page's slot,
+// or at the slot of its finest resident ancestor, so a region the camera just turned to is shown
+// blurry rather than missing. The six coarsest pages are generated up front and never evicted.
+class VirtualTexture {
+public:
+    ~VirtualTexture();
+
+    // Drops every page and starts over for the job's planet, which must not be banded. A compressed
+    // atlas holds BC1 blocks, encoded by the workers with each page, at an eighth of the memory.
+    // GL thread only.
+    void start(const TerrainGenerator *terrain, const TerrainJob &job, bool compressed = false);
+
+    // Waits for the workers and releases the atlas and page table. GL thread only.
+    void stop();
+
+    bool isActive() const { return m_atlas != 0; };
+
+    // GL thread, once per frame: selects the pages the camera needs, given its position and unit
+    // view direction in the planet's object space, where the planet has radius 0.5, the half
+    // angle of a cone around the view direction that holds the view frustum, and the angle a
+    // pixel subtends; queues the missing ones, and uploads at most MAX_UPLOADS_PER_FRAME pages
+    void update(glm::vec3 camera, glm::vec3 look, float coneAngle, float pixelAngle);
+
+    // Binds the atlas and the page table to texture units unit and unit + 1, and sets the
+    // shader's virtual texture uniforms
+    void bind(GLuint shader, int unit) const;
+
+    // Texels of a page, and of its slot in the atlas, which adds a border of texels from the
+    // neighbouring pages on each side so that bilinear filtering needs no other page
+    inline static const int PAGE_TEXELS = 126;
+    inline static const int SLOT_TEXELS = 128;
+
+    inline static const int LEVELS = 6;
+    inline static const int PAGES_PER_FACE = 1 << (LEVELS - 1);
+    inline static const int ATLAS_SLOTS = 16;
+
+    // Pages generated at once, and uploaded per frame
+    inline static const int MAX_IN_FLIGHT = 16;
+    inline static const int MAX_UPLOADS_PER_FRAME = 8;
+
+private:
+    struct Page {
+        int level;      // 0 is the finest
+        int face;
+        int row;
+        int col;
+
+        int key() const { return ((level * 6 + face) * PAGES_PER_FACE + row) * PAGES_PER_FACE + col; };
+        static Page fromKey(int key);
+    };
+
+    struct Slot {
+        int key = -1;               // page held, or -1
+        std::uint64_t used = 0;     // frame the page was last needed in
+    };
+
+    struct Result {
+        int key;
+        std::vector<std::uint8_t> texels;   // or BC1 blocks, if the atlas is compressed
+    };
+
+    // Hands the page to the pool, whose result lands in m_results
+    void request(const Page &page);
+
+    // Uploads at most max finished pages into free or evicted slots
+    void uploadResults(int max);
+
+    int allocateSlot();
+    void updatePageTable();
+
+    const TerrainGenerator *m_terrain = nullptr;
+    TerrainJob m_job;
+    bool m_compressed = false;
+    std::unique_ptr<WorkStealingPool> m_pool;
+
+    std::mutex m_mutex;
+    std::vector<Result> m_results;          // guarded by m_mutex
+
+    // GL thread only
+    GLuint m_atlas = 0;
+    GLuint m_page_table = 0;
+    std::vector<Slot> m_slots;
+    std::unordered_map<int, int> m_resident;    // slot of every page in the atlas
+    std::unordered_set<int> m_in_flight;        // pages handed to the pool
+    std::uint64_t m_frame = 0;
+    bool m_table_dirty = false;
+};
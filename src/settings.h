@@ -21,7 +21,12 @@ struct Settings {
     bool showOrbits = true;
     bool proceduralTexture = false;
     bool normalMapping = false;
+    bool gpuTextures = false;       // bake procedural color maps on the GPU, applied on the next scene load
+    bool clouds = false;            // animated clouds over rocky planets, applied on the next scene load
+    bool displacedTerrain = false;  // the orbited planet as displaced geometry rather than a textured sphere
+    bool compressTextures = false;  // block-compress generated color and normal maps, applied on the next scene load
     int numPlanet = 9;
+    unsigned int textureSeed = 0;   // base seed of the solar system's procedural textures
 };
 
 
@@ -0,0 +1,74 @@
+#include "utils/bandsynthesizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "glm/gtc/constants.hpp"
+
+BandSynthesizer::BandSynthesizer(const std::vector<BandStop> &stops, const std::vector<glm::vec3> &palette,
+                                 int resolution, float turbulence, const NoiseTable &noise)
+    : m_resolution(resolution), m_scale(resolution / 512.f) {
+    int width = resolution * 2;
+
+    // Quadratic Bezier from 0 through the row's peak back to 0, evaluated at column pairs:
+    // (1 - t)^2 * 0 + 2 * (1 - t) * t * peak + t^2 * 0 = weight * peak
+    m_weights.resize(width);
+    for (int y = 0; y < width; ++y) {
+        float t = float(y / 2) / resolution;
+        m_weights[y] = 2 * (1 - t) * t;
+    }
+    m_peaks.resize(resolution);
+    for (int x = 0; x < resolution; ++x) {
+        m_peaks[x] = 75 + int(x / m_scale) % 25;
+    }
+
+    // Turbulence varies along the columns on a circle through the noise, so that it wraps around
+    // the planet without a seam, and is modulated per row
+    m_wobble.assign(width, 0.f);
+    m_swirl.assign(resolution, 0.f);
+    if (turbulence != 0) {
+        for (int y = 0; y < width; ++y) {
+            float angle = 2 * glm::pi<float>() * y / width;
+            m_wobble[y] = turbulence * m_scale * PerlinKernel::perlin(noise, 3 * std::cos(angle), 3 * std::sin(angle));
+        }
+        for (int x = 0; x < resolution; ++x) {
+            m_swirl[x] = 2 * PerlinKernel::perlin(noise, 12.f * x / resolution + 0.5f, 7.5f);
+        }
+    }
+
+    // Bound every shift the tables can produce, so that the ramp needs no clamping per texel
+    auto largest = [](const std::vector<float> &values) {
+        float result = 0;
+        for (float v: values) result = std::max(result, std::abs(v));
+        return result;
+    };
+    float shift = largest(m_weights) * largest(m_peaks) * m_scale + largest(m_wobble) * largest(m_swirl);
+    m_pad = int(std::ceil(shift)) + 1;
+
+    // Quantize the bands once, over every shifted row
+    m_ramp.resize((resolution + 2 * m_pad) * 4);
+    for (int i = 0; i < resolution + 2 * m_pad; ++i) {
+        int row = i - m_pad;
+        int band = 0;
+        while (band + 1 < int(stops.size()) && row >= int(stops[band].end * resolution)) band += 1;
+
+        auto c = glm::clamp(palette[stops[band].color], 0.f, 1.f) * 255.f + 0.5f;
+        m_ramp[i * 4] = (std::uint8_t)c.x;
+        m_ramp[i * 4 + 1] = (std::uint8_t)c.y;
+        m_ramp[i * 4 + 2] = (std::uint8_t)c.z;
+        m_ramp[i * 4 + 3] = 255;
+    }
+}
+
+std::vector<BandStop> BandSynthesizer::defaultStops() {
+    return {{1 / 8.f, 3}, {2 / 8.f, 2}, {7 / 16.f, 1}, {5 / 8.f, 0}, {6 / 8.f, 1}, {7 / 8.f, 2}, {1.f, 3}};
+}
+
+void BandSynthesizer::fill(int row, int col, int width, int height, std::uint8_t *out, std::size_t stride) const {
+    for (int x = row; x < row + height; ++x) {
+        std::uint8_t *texels = out + (x - row) * stride;
+        for (int y = col; y < col + width; ++y) {
+            std::memcpy(texels + (y - col) * 4, texel(x, y), 4);
+        }
+    }
+}
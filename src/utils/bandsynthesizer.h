@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "utils/perlinkernel.h"
+
+// One band of a banded (gas giant) color map: rows up to end * resolution take palette[color].
+// Rows past the last stop keep its color.
+struct BandStop {
+    float end;
+    int color;
+};
+
+// Generates banded color maps from separable tables instead of evaluating bands per texel.
+// Texel (x, y) of the (2 * resolution) x resolution map shows the band of the shifted row
+//
+//     x + weight[y] * peak[x] * scale + wobble[y] * swirl[x]
+//
+// where weight is the quadratic Bezier bulge across the columns, peak the per-row amplitude and
+// wobble / swirl an optional turbulence term sampled from the job's noise. The bands themselves
+// are quantized once into an RGBA8 ramp over all reachable shifted rows, so a texel costs two
+// multiply-adds and a 4-byte copy, whatever the number of stops.
+class BandSynthesizer {
+public:
+    // turbulence is the largest extra shift in rows of a 512 map, 0 for straight Bezier bands
+    BandSynthesizer(const std::vector<BandStop> &stops, const std::vector<glm::vec3> &palette,
+                    int resolution, float turbulence, const NoiseTable &noise);
+
+    // The seven-band layout shared by all gas giants
+    static std::vector<BandStop> defaultStops();
+
+    // RGBA8 texel at row x, column y of the map
+    const std::uint8_t *texel(int x, int y) const {
+        float offset = m_weights[y] * m_peaks[x] * m_scale + m_wobble[y] * m_swirl[x];
+        return &m_ramp[(int(x + offset) + m_pad) * 4];
+    };
+
+    // Fills the width x height texels from (row, col) on; out points at the first, rows are stride
+    // bytes apart
+    void fill(int row, int col, int width, int height, std::uint8_t *out, std::size_t stride) const;
+
+    // Tables for the GPU baker, which performs the same lookup per fragment
+    const std::vector<float> &weights() const { return m_weights; };
+    const std::vector<float> &peaks() const { return m_peaks; };
+    const std::vector<float> &wobble() const { return m_wobble; };
+    const std::vector<float> &swirl() const { return m_swirl; };
+    const std::vector<std::uint8_t> &ramp() const { return m_ramp; };
+    int pad() const { return m_pad; };
+    float scale() const { return m_scale; };
+
+private:
+    int m_resolution;
+    float m_scale;                      // band offsets are authored in rows of a 512 map
+    std::vector<float> m_weights;       // per column
+    std::vector<float> m_peaks;         // per row
+    std::vector<float> m_wobble;        // per column
+    std::vector<float> m_swirl;         // per row
+    int m_pad;                          // ramp rows below 0, and above resolution - 1
+    std::vector<std::uint8_t> m_ramp;   // shifted rows [-m_pad, resolution + m_pad)
+};
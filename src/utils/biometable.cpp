@@ -0,0 +1,55 @@
+#include "utils/biometable.h"
+
+#include <algorithm>
+#include <cstring>
+
+BiomeTable BiomeTable::compile(const std::vector<glm::vec3> &palette) {
+    BiomeTable table;
+    for (int m = 0; m < SIZE; ++m) {
+        for (int t = 0; t < SIZE; ++t) {
+            auto c = glm::clamp(blend(palette, float(t) / (SIZE - 1), float(m) / (SIZE - 1)), 0.f, 1.f) * 255.f + 0.5f;
+            std::uint8_t texel[4] = {(std::uint8_t)c.x, (std::uint8_t)c.y, (std::uint8_t)c.z, 255};
+            std::memcpy(&table.texels[m * SIZE + t], texel, 4);
+        }
+    }
+    return table;
+}
+
+glm::vec3 BiomeTable::blend(const std::vector<glm::vec3> &palette, float temperature, float moisture) {
+    float warmth = glm::smoothstep(0.25f, 0.45f, temperature);
+    auto dry = glm::mix(palette[3], palette[1], warmth);
+    auto wet = glm::mix(palette[3], palette[2] * glm::mix(1.1f, 0.75f, temperature), warmth);
+    return glm::mix(dry, wet, glm::smoothstep(0.35f, 0.65f, moisture));
+}
+
+glm::vec4 BiomeTable::sample(float temperature, float moisture) const {
+    float t = glm::clamp(temperature, 0.f, 1.f) * (SIZE - 1);
+    float m = glm::clamp(moisture, 0.f, 1.f) * (SIZE - 1);
+    int t0 = std::min(int(t), SIZE - 2);
+    int m0 = std::min(int(m), SIZE - 2);
+    auto texel = [this](int row, int col) {
+        std::uint8_t c[4];
+        std::memcpy(c, &texels[row * SIZE + col], 4);
+        return glm::vec4(c[0], c[1], c[2], c[3]);
+    };
+    auto dry = glm::mix(texel(m0, t0), texel(m0, t0 + 1), t - t0);
+    auto wet = glm::mix(texel(m0 + 1, t0), texel(m0 + 1, t0 + 1), t - t0);
+    return glm::mix(dry, wet, m - m0);
+}
+
+void BiomeTable::shadeRow(const PaletteRamp &ramp, const float *heights, const float *temperatures,
+                          const float *moistures, int count, std::uint8_t *out) const {
+    for (int i = 0; i < count; ++i) {
+        std::uint8_t *texel = out + i * 4;
+        std::uint32_t water = ramp.sample(heights[i]);
+        float land = glm::clamp((heights[i] - LAND_MIN) / (LAND_MAX - LAND_MIN), 0.f, 1.f);
+        if (land == 0.f) {
+            std::memcpy(texel, &water, 4);
+            continue;
+        }
+        auto biome = sample(temperatures[i], moistures[i]);
+        std::uint8_t a[4];
+        std::memcpy(a, &water, 4);
+        for (int c = 0; c < 4; ++c) texel[c] = (std::uint8_t)(a[c] + (biome[c] - a[c]) * land + 0.5f);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+#include "utils/paletteramp.h"
+
+// Land colors of a planet by climate, compiled from its palette into a SIZE x SIZE grid of RGBA8
+// texels over temperature and moisture in [0, 1], which are clamped like PaletteRamp heights. Cold land takes the palette's highest color (snow, ice), warm dry land its shore color
+// and warm wet land its lowland color, darker the hotter it is. Immutable once compiled.
+struct BiomeTable {
+    static constexpr int SIZE = 64;
+
+    // Land fades in over the palette's shore-to-lowland blend, the water and shore below it keep
+    // their PaletteRamp colors
+    static constexpr float LAND_MIN = 0.01f;
+    static constexpr float LAND_MAX = 0.02f;
+
+    std::array<std::uint32_t, SIZE * SIZE> texels;  // rows of constant moisture, RGBA8 in memory order
+
+    static BiomeTable compile(const std::vector<glm::vec3> &palette);
+
+    // Color of a climate as blended from the palette before quantization
+    static glm::vec3 blend(const std::vector<glm::vec3> &palette, float temperature, float moisture);
+
+    // Climate of a point on the sphere from its noise channels: temperature falls towards the
+    // poles (sinLatitude = +-1) and with altitude, moisture is the channel alone
+    static float temperature(float channel, float sinLatitude, float height) {
+        return 0.85f + 2.5f * channel - 0.6f * sinLatitude * sinLatitude - 1.5f * std::max(height, 0.f);
+    };
+    static float moisture(float channel) { return 0.5f + 3.f * channel; };
+
+    // RGBA in [0, 255], bilinear between the four texels around the climate, so that the color
+    // varies continuously with it and noise that differs in its last bits (e.g. the GPU baker's)
+    // lands on nearly the same color
+    glm::vec4 sample(float temperature, float moisture) const;
+
+    // Final RGBA8 texels of a row of land and sea: the ramp's color of each height, blended into
+    // the biome's color over [LAND_MIN, LAND_MAX]. out needs no alignment.
+    void shadeRow(const PaletteRamp &ramp, const float *heights, const float *temperatures,
+                  const float *moistures, int count, std::uint8_t *out) const;
+};
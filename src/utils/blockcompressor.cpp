@@ -0,0 +1,279 @@
+#include "utils/blockcompressor.h"
+#include "utils/parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Power iterations that find a block's principal axis, enough for 16 texels
+static const int AXIS_ITERATIONS = 4;
+
+std::size_t BlockCompressor::bc1Size(int width, int height) {
+    return std::size_t(width / 4) * (height / 4) * BC1_BLOCK_BYTES;
+}
+
+std::size_t BlockCompressor::bc5Size(int width, int height) {
+    return std::size_t(width / 4) * (height / 4) * BC5_BLOCK_BYTES;
+}
+
+static inline std::uint16_t pack565(const int c[3]) {
+    int r = (c[0] * 31 + 127) / 255;
+    int g = (c[1] * 63 + 127) / 255;
+    int b = (c[2] * 31 + 127) / 255;
+    return std::uint16_t(r << 11 | g << 5 | b);
+}
+
+static inline void unpack565(std::uint16_t v, int c[3]) {
+    int r = v >> 11 & 31, g = v >> 5 & 63, b = v & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+// The colors a BC1 block's indices select from, as GL decodes them: four on the line between the
+// endpoints if the first is the larger 565 value, else three and black
+static void bc1Palette(std::uint16_t c0, std::uint16_t c1, int palette[4][3]) {
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        if (c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+// A BC1 block's endpoints and indices, and their squared error over the block
+struct BC1Fit {
+    std::uint16_t c0 = 0;
+    std::uint16_t c1 = 0;
+    std::uint32_t indices = 0;
+    int picks[16] = {};
+    int error = 0;
+};
+
+// Fits the block with the four colors between endpoints a and b, each texel taking its nearest
+static BC1Fit fitBC1(const int texels[16][3], const int a[3], const int b[3]) {
+    BC1Fit fit;
+    fit.c0 = pack565(a);
+    fit.c1 = pack565(b);
+    if (fit.c0 < fit.c1) std::swap(fit.c0, fit.c1);
+
+    // Equal endpoints leave the three-color mode, where index 0 is their color
+    int palette[4][3];
+    bc1Palette(fit.c0, fit.c1, palette);
+    int candidates = fit.c0 == fit.c1 ? 1 : 4;
+    for (int i = 0; i < 16; ++i) {
+        int best = 0, best_error = 0;
+        for (int p = 0; p < candidates; ++p) {
+            int dr = texels[i][0] - palette[p][0];
+            int dg = texels[i][1] - palette[p][1];
+            int db = texels[i][2] - palette[p][2];
+            int error = dr * dr + dg * dg + db * db;
+            if (p == 0 || error < best_error) {
+                best = p;
+                best_error = error;
+            }
+        }
+        fit.picks[i] = best;
+        fit.indices |= std::uint32_t(best) << (2 * i);
+        fit.error += best_error;
+    }
+    return fit;
+}
+
+// The endpoints that minimize the squared error of a fit's picks, each texel weighted along the
+// line by its index, or false if all picks share one weight
+static bool refineBC1(const int texels[16][3], const BC1Fit &fit, int a[3], int b[3]) {
+    static const float WEIGHTS[4] = {0.f, 1.f, 1.f / 3, 2.f / 3};
+
+    float aa = 0, ab = 0, bb = 0, ax[3] = {}, bx[3] = {};
+    for (int i = 0; i < 16; ++i) {
+        float beta = WEIGHTS[fit.picks[i]], alpha = 1 - beta;
+        aa += alpha * alpha;
+        ab += alpha * beta;
+        bb += beta * beta;
+        for (int c = 0; c < 3; ++c) {
+            ax[c] += alpha * texels[i][c];
+            bx[c] += beta * texels[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-4f) return false;
+
+    for (int c = 0; c < 3; ++c) {
+        float ea = (bb * ax[c] - ab * bx[c]) / det;
+        float eb = (aa * bx[c] - ab * ax[c]) / det;
+        a[c] = std::clamp(int(std::lround(ea)), 0, 255);
+        b[c] = std::clamp(int(std::lround(eb)), 0, 255);
+    }
+    return true;
+}
+
+static void encodeBC1Block(const std::uint8_t *rgba, std::size_t stride, std::uint8_t *out) {
+    int texels[16][3];
+    float mean[3] = {};
+    bool solid = true;
+    for (int i = 0; i < 16; ++i) {
+        const std::uint8_t *texel = rgba + (i / 4) * stride + (i % 4) * 4;
+        for (int c = 0; c < 3; ++c) {
+            texels[i][c] = texel[c];
+            mean[c] += texel[c] / 16.f;
+            solid = solid && texel[c] == texels[0][c];
+        }
+    }
+
+    BC1Fit fit;
+    if (solid) {
+        fit = fitBC1(texels, texels[0], texels[0]);
+    } else {
+        // Principal axis of the colors, by power iteration from the covariance's row of the
+        // channel that varies the most
+        float cov[3][3] = {};
+        for (int i = 0; i < 16; ++i) {
+            float d[3] = {texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2]};
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 3; ++c) cov[r][c] += d[r] * d[c];
+            }
+        }
+        int widest = cov[1][1] > cov[0][0] ? 1 : 0;
+        if (cov[2][2] > cov[widest][widest]) widest = 2;
+        float axis[3] = {cov[widest][0], cov[widest][1], cov[widest][2]};
+        for (int k = 0; k < AXIS_ITERATIONS; ++k) {
+            float next[3];
+            for (int r = 0; r < 3; ++r) next[r] = cov[r][0] * axis[0] + cov[r][1] * axis[1] + cov[r][2] * axis[2];
+            float scale = std::max({std::abs(next[0]), std::abs(next[1]), std::abs(next[2])});
+            if (scale == 0) break;
+            for (int r = 0; r < 3; ++r) axis[r] = next[r] / scale;
+        }
+
+        // The texels farthest apart along it are the first fit's endpoints
+        int lo = 0, hi = 0;
+        float lo_t = 0, hi_t = 0;
+        for (int i = 0; i < 16; ++i) {
+            float t = texels[i][0] * axis[0] + texels[i][1] * axis[1] + texels[i][2] * axis[2];
+            if (i == 0 || t < lo_t) { lo = i; lo_t = t; }
+            if (i == 0 || t > hi_t) { hi = i; hi_t = t; }
+        }
+        fit = fitBC1(texels, texels[hi], texels[lo]);
+
+        int a[3], b[3];
+        if (fit.c0 != fit.c1 && refineBC1(texels, fit, a, b)) {
+            BC1Fit refined = fitBC1(texels, a, b);
+            if (refined.error < fit.error) fit = refined;
+        }
+    }
+
+    out[0] = fit.c0 & 0xff;
+    out[1] = fit.c0 >> 8;
+    out[2] = fit.c1 & 0xff;
+    out[3] = fit.c1 >> 8;
+    for (int k = 0; k < 4; ++k) out[4 + k] = (fit.indices >> (8 * k)) & 0xff;
+}
+
+// One channel of a BC5 block, as a BC4 block over the range of its values: the endpoints are the
+// largest and smallest value, so the eight-value mode applies, and each texel takes the nearest of
+// the eight. Texels are `step` bytes apart within a row.
+static void encodeBC4Block(const std::uint8_t *texels, std::size_t stride, int step, std::uint8_t *out) {
+    int values[16];
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i) {
+        values[i] = texels[(i / 4) * stride + (i % 4) * step];
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+
+    // Indices 0 and 1 are the endpoints, 2 to 7 the values between them from the largest down
+    std::uint64_t bits = 0;
+    if (hi > lo) {
+        int range = hi - lo;
+        for (int i = 0; i < 16; ++i) {
+            int k = ((hi - values[i]) * 14 + range) / (2 * range);
+            int index = k == 0 ? 0 : k == 7 ? 1 : k + 1;
+            bits |= std::uint64_t(index) << (3 * i);
+        }
+    }
+    out[0] = std::uint8_t(hi);
+    out[1] = std::uint8_t(lo);
+    for (int k = 0; k < 6; ++k) out[2 + k] = (bits >> (8 * k)) & 0xff;
+}
+
+void BlockCompressor::encodeBC1Blocks(const std::uint8_t *rgba, std::size_t stride, int width, int height,
+                                      std::uint8_t *out, std::size_t outStride) {
+    for (int row = 0; row < height; row += 4) {
+        std::uint8_t *blocks = out + (row / 4) * outStride;
+        for (int col = 0; col < width; col += 4) {
+            encodeBC1Block(rgba + row * stride + col * 4, stride, blocks + (col / 4) * BC1_BLOCK_BYTES);
+        }
+    }
+}
+
+void BlockCompressor::encodeBC5Blocks(const std::uint8_t *rg, std::size_t stride, int width, int height,
+                                      std::uint8_t *out, std::size_t outStride) {
+    for (int row = 0; row < height; row += 4) {
+        std::uint8_t *blocks = out + (row / 4) * outStride;
+        for (int col = 0; col < width; col += 4) {
+            const std::uint8_t *texels = rg + row * stride + col * 2;
+            std::uint8_t *block = blocks + (col / 4) * BC5_BLOCK_BYTES;
+            encodeBC4Block(texels, stride, 2, block);
+            encodeBC4Block(texels + 1, stride, 2, block + 8);
+        }
+    }
+}
+
+void BlockCompressor::encodeBC1(const std::uint8_t *rgba, int width, int height, std::uint8_t *out, int threads) {
+    int rows = height / 4;
+    parallelFor((rows + BLOCK_ROWS - 1) / BLOCK_ROWS, [&](int item) {
+        int row = item * BLOCK_ROWS, end = std::min(row + BLOCK_ROWS, rows);
+        encodeBC1Blocks(rgba + std::size_t(row) * 4 * width * 4, width * 4, width, (end - row) * 4,
+                        out + row * bc1Size(width, 4), bc1Size(width, 4));
+    }, threads);
+}
+
+void BlockCompressor::encodeBC5(const std::uint8_t *rg, int width, int height, std::uint8_t *out, int threads) {
+    int rows = height / 4;
+    parallelFor((rows + BLOCK_ROWS - 1) / BLOCK_ROWS, [&](int item) {
+        int row = item * BLOCK_ROWS, end = std::min(row + BLOCK_ROWS, rows);
+        encodeBC5Blocks(rg + std::size_t(row) * 4 * width * 2, width * 2, width, (end - row) * 4,
+                        out + row * bc5Size(width, 4), bc5Size(width, 4));
+    }, threads);
+}
+
+void BlockCompressor::decodeBC1(const std::uint8_t *blocks, int width, int height, std::uint8_t *rgba) {
+    for (int row = 0; row < height; row += 4) {
+        for (int col = 0; col < width; col += 4, blocks += BC1_BLOCK_BYTES) {
+            int palette[4][3];
+            bc1Palette(std::uint16_t(blocks[0] | blocks[1] << 8), std::uint16_t(blocks[2] | blocks[3] << 8), palette);
+            std::uint32_t indices = blocks[4] | blocks[5] << 8 | blocks[6] << 16 | std::uint32_t(blocks[7]) << 24;
+            for (int i = 0; i < 16; ++i) {
+                std::uint8_t *texel = rgba + (std::size_t(row + i / 4) * width + col + i % 4) * 4;
+                const int *color = palette[indices >> (2 * i) & 3];
+                for (int c = 0; c < 3; ++c) texel[c] = std::uint8_t(color[c]);
+                texel[3] = 255;
+            }
+        }
+    }
+}
+
+void BlockCompressor::decodeBC5(const std::uint8_t *blocks, int width, int height, std::uint8_t *rg) {
+    for (int row = 0; row < height; row += 4) {
+        for (int col = 0; col < width; col += 4, blocks += BC5_BLOCK_BYTES) {
+            for (int channel = 0; channel < 2; ++channel) {
+                const std::uint8_t *block = blocks + 8 * channel;
+                int hi = block[0], lo = block[1], palette[8] = {hi, lo};
+                for (int k = 2; k < 8; ++k) {
+                    palette[k] = hi > lo ? ((8 - k) * hi + (k - 1) * lo + 3) / 7
+                             : k < 6 ? ((6 - k) * hi + (k - 1) * lo + 2) / 5
+                             : k == 6 ? 0 : 255;
+                }
+                std::uint64_t bits = 0;
+                for (int k = 0; k < 6; ++k) bits |= std::uint64_t(block[2 + k]) << (8 * k);
+                for (int i = 0; i < 16; ++i) {
+                    rg[(std::size_t(row + i / 4) * width + col + i % 4) * 2 + channel] = std::uint8_t(palette[bits >> (3 * i) & 7]);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CPU encoders for the block-compressed formats GL samples directly, so that generated maps take a
+// fraction of their memory on the GPU: BC1 (S3TC DXT1) for RGBA8 color maps, at 8 bytes per 4 x 4
+// block or an eighth of their size, and BC5 (RGTC2) for RG8 normal maps, at 16 bytes per block or
+// half their size. Images are encoded in whole blocks, so their sides must be multiples of 4, and
+// their blocks are stored row by row as glCompressedTexImage2D() takes them. A cube map's faces,
+// stacked as the rows of one image as in TerrainJob, are one face after another in its blocks.
+//
+// BC1 fits each block's colors with the line through them along their principal axis, picks each
+// texel's nearest of the four colors on it, then refits the line to those picks by least squares
+// and keeps whichever fit is closer. BC5 encodes each channel over the range of its 16 values.
+class BlockCompressor {
+public:
+    inline static const int BC1_BLOCK_BYTES = 8;
+    inline static const int BC5_BLOCK_BYTES = 16;
+
+    // Bytes of the blocks of a width x height image
+    static std::size_t bc1Size(int width, int height);
+    static std::size_t bc5Size(int width, int height);
+
+    // Encodes a width x height region of an image, whose rows start stride bytes apart, into
+    // blocks whose rows start outStride bytes apart, e.g. a tile of a larger map. Alpha is ignored.
+    static void encodeBC1Blocks(const std::uint8_t *rgba, std::size_t stride, int width, int height,
+                                std::uint8_t *out, std::size_t outStride);
+    static void encodeBC5Blocks(const std::uint8_t *rg, std::size_t stride, int width, int height,
+                                std::uint8_t *out, std::size_t outStride);
+
+    // Encodes a whole tightly packed image into bc1Size() or bc5Size() bytes on `threads` threads
+    // (all hardware threads if 0), BLOCK_ROWS rows of blocks per work item
+    static void encodeBC1(const std::uint8_t *rgba, int width, int height, std::uint8_t *out, int threads = 0);
+    static void encodeBC5(const std::uint8_t *rg, int width, int height, std::uint8_t *out, int threads = 0);
+
+    // The texels GL decodes a whole image's blocks to, to read a compressed texture back into an
+    // uncompressed one and to measure the encoders' error. BC1 decodes to opaque RGBA8.
+    static void decodeBC1(const std::uint8_t *blocks, int width, int height, std::uint8_t *rgba);
+    static void decodeBC5(const std::uint8_t *blocks, int width, int height, std::uint8_t *rg);
+
+    inline static const int BLOCK_ROWS = 4;
+};
@@ -0,0 +1,253 @@
+#include "utils/craterkernel.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define CRATER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CRATER_TARGET_AVX2
+#else
+#define CRATER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Shape of a crater, in units of its cell: the feature point lies within JITTER of the cell
+// center, radii range over [RADIUS_MIN, RADIUS_MAX] with small craters the most common, and the
+// rim rises RIM times the depth and falls off over RIM_WIDTH radii. The widest crater reaches
+// 1.5 * RADIUS_MAX = 0.6, less than the 1 - JITTER = 0.7 between a cell's far half and any
+// feature point beyond the next cell, so the 2 x 2 x 2 cells nearest a sample are all it sees.
+static const float JITTER = 0.3f;
+static const float RADIUS_MIN = 0.15f;
+static const float RADIUS_MAX = 0.4f;
+static const float RIM = 0.25f;
+static const float RIM_WIDTH = 0.5f;
+
+// Derivatives of the bowl, (1 + RIM) * depth * d^2 / r^2, and of the rim, RIM * depth * fall^2
+// with fall = 1 - (d - r) / (RIM_WIDTH * r), along d, without the factors that vary per sample
+static const float BOWL_SLOPE = 2.f * (1.f + RIM);
+static const float RIM_SLOPE = 2.f * RIM / RIM_WIDTH;
+
+Craters Craters::forSpacing(float spacing, float depth, float density) {
+    Craters craters;
+    craters.density = density;
+    if (depth <= 0.f || density <= 0.f) return craters;
+    for (float f = 4.f; craters.count < MAX_SCALES; f *= 2) {
+        // Samples per cell; at 16 and above the scale is kept whole
+        float samples = 1.f / (f * spacing);
+        float fade = std::min(std::max((samples - 8.f) / 8.f, 0.f), 1.f);
+        if (fade == 0.f) break;
+
+        craters.freq[craters.count] = f;
+        craters.depth[craters.count] = depth * fade;
+        craters.count += 1;
+    }
+    return craters;
+}
+
+// Relief of one scale at (x, y, z) in cell units, accumulating its derivatives along the cell
+// axes in grad. depth is per radius in cell units, threshold the lowest hash that holds a crater.
+static float craterCells(const NoiseTable &table, int channel, float depth, float threshold,
+                         float x, float y, float z, float grad[3]) {
+    // The cell below the sample's and its own along each axis where the sample is in its cell's
+    // lower half, else its own and the one above
+    int i0 = (int)std::floor(x - 0.5f);
+    int j0 = (int)std::floor(y - 0.5f);
+    int k0 = (int)std::floor(z - 0.5f);
+
+    float sum = 0.f;
+    for (int i = i0; i <= i0 + 1; ++i) {
+        for (int j = j0; j <= j0 + 1; ++j) {
+            for (int k = k0; k <= k0 + 1; ++k) {
+                int h = table.channelHash(table.hash(i, j, k), channel);
+                float t = (table.gradX[(h + 1) & NoiseTable::MASK] - threshold) / (1.f - threshold);
+                float radius = RADIUS_MIN + (RADIUS_MAX - RADIUS_MIN) * (t * t);
+                float d = t > 0.f ? depth * radius : 0.f;
+
+                float dx = x - (float(i) + 0.5f + JITTER * table.gradX[h]);
+                float dy = y - (float(j) + 0.5f + JITTER * table.gradY[h]);
+                float dz = z - (float(k) + 0.5f + JITTER * table.gradZ[h]);
+                float d2 = dx * dx + dy * dy + dz * dz;
+                float r2 = radius * radius;
+
+                float relief, slope;
+                if (d2 < r2) {
+                    relief = d * ((1.f + RIM) * d2 / r2 - 1.f);
+                    slope = d * BOWL_SLOPE / r2;
+                } else {
+                    float dist = std::sqrt(d2);
+                    float fall = std::max(1.f - (dist - radius) / (RIM_WIDTH * radius), 0.f);
+                    relief = d * RIM * fall * fall;
+                    slope = -(d * RIM_SLOPE) * fall / (radius * dist);
+                }
+                sum += relief;
+                grad[0] += slope * dx;
+                grad[1] += slope * dy;
+                grad[2] += slope * dz;
+            }
+        }
+    }
+    return sum;
+}
+
+float CraterKernel::crater(const NoiseTable &table, const Craters &craters, float x, float y, float z, float grad[3]) {
+    float threshold = 1.f - 2.f * craters.density;
+    float h = 0.f;
+    if (grad != nullptr) grad[0] = grad[1] = grad[2] = 0.f;
+    for (int s = 0; s < craters.count; ++s) {
+        float f = craters.freq[s], g[3] = {0.f, 0.f, 0.f};
+        h += craterCells(table, NoiseTable::MAX_CHANNELS + s, craters.depth[s] / f, threshold,
+                         x * f, y * f, z * f, g);
+        if (grad == nullptr) continue;
+        for (int c = 0; c < 3; ++c) grad[c] += f * g[c];
+    }
+    return h;
+}
+
+void CraterKernel::addPoints(const NoiseTable &table, const Craters &craters,
+                             const float *x, const float *y, const float *z, int count, float *out,
+                             float *gradX, float *gradY, float *gradZ) {
+    if (craters.count == 0) return;
+    if (PerlinKernel::hasAVX2()) {
+        addPointsAVX2(table, craters, x, y, z, count, out, gradX, gradY, gradZ);
+        return;
+    }
+    for (int i = 0; i < count; ++i) {
+        float g[3];
+        out[i] += crater(table, craters, x[i], y[i], z[i], g);
+        if (gradX == nullptr) continue;
+        gradX[i] += g[0];
+        gradY[i] += g[1];
+        gradZ[i] += g[2];
+    }
+}
+
+#ifdef CRATER_X86
+
+// craterCells() for eight samples. The bowl and the rim are both evaluated and one is selected
+// per lane, with the same operations in the same order as the scalar path, so that results match
+// it bit for bit.
+CRATER_TARGET_AVX2
+static __m256 craterCellsAVX2(const NoiseTable &table, int channel, float depth, float threshold,
+                              __m256 x, __m256 y, __m256 z, __m256 grad[3]) {
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), half = _mm256_set1_ps(0.5f);
+    const __m256 jitter = _mm256_set1_ps(JITTER);
+    const __m256 v_depth = _mm256_set1_ps(depth), v_threshold = _mm256_set1_ps(threshold);
+    const __m256 v_spread = _mm256_set1_ps(1.f - threshold);
+    const __m256i v_mask = _mm256_set1_epi32(NoiseTable::MASK);
+    const __m256i v_channel = _mm256_set1_epi32(channel * NoiseTable::CHANNEL_OFFSET);
+
+    __m256i i0 = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_sub_ps(x, half)));
+    __m256i j0 = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_sub_ps(y, half)));
+    __m256i k0 = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_sub_ps(z, half)));
+
+    __m256 sum = zero;
+    for (int di = 0; di <= 1; ++di) {
+        __m256i i = _mm256_add_epi32(i0, _mm256_set1_epi32(di));
+        for (int dj = 0; dj <= 1; ++dj) {
+            __m256i j = _mm256_add_epi32(j0, _mm256_set1_epi32(dj));
+            for (int dk = 0; dk <= 1; ++dk) {
+                __m256i k = _mm256_add_epi32(k0, _mm256_set1_epi32(dk));
+                __m256i h = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(i, _mm256_set1_epi32(41)),
+                                                              _mm256_mullo_epi32(j, _mm256_set1_epi32(43))),
+                                             _mm256_mullo_epi32(k, _mm256_set1_epi32(47)));
+                h = _mm256_and_si256(_mm256_add_epi32(h, v_channel), v_mask);
+                __m256i h_next = _mm256_and_si256(_mm256_add_epi32(h, _mm256_set1_epi32(1)), v_mask);
+
+                __m256 t = _mm256_div_ps(_mm256_sub_ps(_mm256_i32gather_ps(table.gradX.data(), h_next, 4), v_threshold),
+                                         v_spread);
+                __m256 radius = _mm256_add_ps(_mm256_set1_ps(RADIUS_MIN),
+                                              _mm256_mul_ps(_mm256_set1_ps(RADIUS_MAX - RADIUS_MIN), _mm256_mul_ps(t, t)));
+                __m256 d = _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_mul_ps(v_depth, radius));
+
+                __m256 fx = _mm256_add_ps(_mm256_add_ps(_mm256_cvtepi32_ps(i), half),
+                                          _mm256_mul_ps(jitter, _mm256_i32gather_ps(table.gradX.data(), h, 4)));
+                __m256 fy = _mm256_add_ps(_mm256_add_ps(_mm256_cvtepi32_ps(j), half),
+                                          _mm256_mul_ps(jitter, _mm256_i32gather_ps(table.gradY.data(), h, 4)));
+                __m256 fz = _mm256_add_ps(_mm256_add_ps(_mm256_cvtepi32_ps(k), half),
+                                          _mm256_mul_ps(jitter, _mm256_i32gather_ps(table.gradZ.data(), h, 4)));
+                __m256 dx = _mm256_sub_ps(x, fx), dy = _mm256_sub_ps(y, fy), dz = _mm256_sub_ps(z, fz);
+                __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+                                          _mm256_mul_ps(dz, dz));
+                __m256 r2 = _mm256_mul_ps(radius, radius);
+                __m256 inside = _mm256_cmp_ps(d2, r2, _CMP_LT_OQ);
+
+                __m256 bowl = _mm256_mul_ps(d, _mm256_sub_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(1.f + RIM), d2), r2),
+                                                             one));
+                __m256 bowl_slope = _mm256_div_ps(_mm256_mul_ps(d, _mm256_set1_ps(BOWL_SLOPE)), r2);
+
+                __m256 dist = _mm256_sqrt_ps(d2);
+                __m256 fall = _mm256_sub_ps(one, _mm256_div_ps(_mm256_sub_ps(dist, radius),
+                                                              _mm256_mul_ps(_mm256_set1_ps(RIM_WIDTH), radius)));
+                fall = _mm256_max_ps(fall, zero);
+                __m256 rim = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(d, _mm256_set1_ps(RIM)), fall), fall);
+                __m256 rim_slope = _mm256_div_ps(_mm256_mul_ps(_mm256_xor_ps(_mm256_mul_ps(d, _mm256_set1_ps(RIM_SLOPE)), _mm256_set1_ps(-0.f)), fall),
+                                                 _mm256_mul_ps(radius, dist));
+
+                __m256 slope = _mm256_blendv_ps(rim_slope, bowl_slope, inside);
+                sum = _mm256_add_ps(sum, _mm256_blendv_ps(rim, bowl, inside));
+                grad[0] = _mm256_add_ps(grad[0], _mm256_mul_ps(slope, dx));
+                grad[1] = _mm256_add_ps(grad[1], _mm256_mul_ps(slope, dy));
+                grad[2] = _mm256_add_ps(grad[2], _mm256_mul_ps(slope, dz));
+            }
+        }
+    }
+    return sum;
+}
+
+CRATER_TARGET_AVX2
+void CraterKernel::addPointsAVX2(const NoiseTable &table, const Craters &craters,
+                                 const float *x, const float *y, const float *z, int count, float *out,
+                                 float *gradX, float *gradY, float *gradZ) {
+    float threshold = 1.f - 2.f * craters.density;
+    float *grads[3] = { gradX, gradY, gradZ };
+
+    int n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m256 px = _mm256_loadu_ps(x + n), py = _mm256_loadu_ps(y + n), pz = _mm256_loadu_ps(z + n);
+        __m256 h = _mm256_setzero_ps();
+        __m256 deriv[3] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+        for (int s = 0; s < craters.count; ++s) {
+            float f = craters.freq[s];
+            __m256 v_freq = _mm256_set1_ps(f);
+            __m256 g[3] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+            h = _mm256_add_ps(h, craterCellsAVX2(table, NoiseTable::MAX_CHANNELS + s, craters.depth[s] / f, threshold,
+                                                 _mm256_mul_ps(px, v_freq), _mm256_mul_ps(py, v_freq),
+                                                 _mm256_mul_ps(pz, v_freq), g));
+            for (int a = 0; a < 3; ++a) deriv[a] = _mm256_add_ps(deriv[a], _mm256_mul_ps(v_freq, g[a]));
+        }
+
+        _mm256_storeu_ps(out + n, _mm256_add_ps(_mm256_loadu_ps(out + n), h));
+        if (gradX == nullptr) continue;
+        for (int a = 0; a < 3; ++a) {
+            _mm256_storeu_ps(grads[a] + n, _mm256_add_ps(_mm256_loadu_ps(grads[a] + n), deriv[a]));
+        }
+    }
+
+    for (; n < count; ++n) {
+        float g[3];
+        out[n] += crater(table, craters, x[n], y[n], z[n], g);
+        if (gradX == nullptr) continue;
+        gradX[n] += g[0];
+        gradY[n] += g[1];
+        gradZ[n] += g[2];
+    }
+}
+
+#else
+
+void CraterKernel::addPointsAVX2(const NoiseTable &table, const Craters &craters,
+                                 const float *x, const float *y, const float *z, int count, float *out,
+                                 float *gradX, float *gradY, float *gradZ) {
+    for (int n = 0; n < count; ++n) {
+        float g[3];
+        out[n] += crater(table, craters, x[n], y[n], z[n], g);
+        if (gradX == nullptr) continue;
+        gradX[n] += g[0];
+        gradY[n] += g[1];
+        gradZ[n] += g[2];
+    }
+}
+
+#endif
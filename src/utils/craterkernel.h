@@ -0,0 +1,46 @@
+#pragma once
+
+#include "utils/perlinkernel.h"
+
+// Scales of a crater layer, each a grid of cells that hold at most one crater, largest first.
+// forSpacing() keeps the scales whose cells span at least 8 samples, fading each one in until
+// 16, so that the smallest craters are still a few texels across.
+struct Craters {
+    static constexpr int MAX_SCALES = 4;
+
+    int count = 0;
+    float freq[MAX_SCALES] = {};    // cells per noise unit
+    float depth[MAX_SCALES] = {};   // depth of a crater per unit of its radius, both in noise units
+    float density = 0;              // fraction of cells that hold a crater
+
+    // Scales for samples `spacing` noise units apart, from 4 cells per noise unit up. Craters
+    // are `depth` times as deep as they are wide, a crater layer of depth 0 has no scales.
+    static Craters forSpacing(float spacing, float depth, float density);
+};
+
+// Cellular (Worley) noise shaped into impact craters. Each cell of a scale's grid hashes to one
+// feature point, jittered about the cell center, and a crater radius. Since feature points stay
+// near their cell's center and craters are smaller than a cell, a sample only visits a constant
+// 2 x 2 x 2 block of cells around it, never a list of feature points. A crater is a parabolic
+// bowl with a raised rim that falls off to zero outside; overlapping craters add up. Cells are
+// hashed like 3D noise lattice corners, as a channel past NoiseTable::MAX_CHANNELS, so craters
+// are independent of every noise channel.
+class CraterKernel {
+public:
+    // Crater relief at (x, y, z), summed over all scales. If grad is not null, it receives the
+    // partial derivatives along x, y and z.
+    static float crater(const NoiseTable &table, const Craters &craters, float x, float y, float z,
+                        float grad[3] = nullptr);
+
+    // out[i] += crater(x[i], y[i], z[i]) for i in [0, count), and likewise the derivatives unless
+    // gradX is null, eight points at a time where AVX2 is available. Matches crater() exactly on
+    // every path.
+    static void addPoints(const NoiseTable &table, const Craters &craters,
+                          const float *x, const float *y, const float *z, int count, float *out,
+                          float *gradX = nullptr, float *gradY = nullptr, float *gradZ = nullptr);
+
+private:
+    static void addPointsAVX2(const NoiseTable &table, const Craters &craters,
+                              const float *x, const float *y, const float *z, int count, float *out,
+                              float *gradX, float *gradY, float *gradZ);
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils/perlinkernel.h"
+#include "utils/simplexkernel.h"
+
+// Gradient noise a terrain job's heights are built from
+enum class NoiseBasis {
+    PERLIN,
+    SIMPLEX,
+};
+
+// Fractal noise evaluators of every basis behind one interface, dispatched per call. Each call
+// covers a whole row or octave sum, so the switch costs nothing next to the sampling.
+class NoiseKernel {
+public:
+    // See PerlinKernel::heightRow()
+    static void heightRow(NoiseBasis basis, const NoiseTable &table, const Octaves &octaves, float x, int col0,
+                          float dz, int count, float *out) {
+        switch (basis) {
+            case NoiseBasis::SIMPLEX: return SimplexKernel::heightRow(table, octaves, x, col0, dz, count, out);
+            default: return PerlinKernel::heightRow(table, octaves, x, col0, dz, count, out);
+        }
+    };
+
+    // Fractal sum of 3D noise over the given octaves
+    static float height(NoiseBasis basis, const NoiseTable &table, const Octaves &octaves, float x, float y, float z) {
+        switch (basis) {
+            case NoiseBasis::SIMPLEX: return SimplexKernel::height(table, octaves, x, y, z);
+            default: return PerlinKernel::height(table, octaves, x, y, z);
+        }
+    };
+
+    // out[i] = height(x[i], y[i], z[i]) for i in [0, count)
+    static void heightPoints(NoiseBasis basis, const NoiseTable &table, const Octaves &octaves,
+                             const float *x, const float *y, const float *z, int count, float *out) {
+        if (basis == NoiseBasis::SIMPLEX) {
+            SimplexKernel::heightPoints(table, octaves, x, y, z, count, out);
+            return;
+        }
+        for (int i = 0; i < count; ++i) out[i] = PerlinKernel::height(table, octaves, x[i], y[i], z[i]);
+    };
+
+    // The same, also writing the partial derivatives of each height along x, y and z
+    static void heightPoints(NoiseBasis basis, const NoiseTable &table, const Octaves &octaves,
+                             const float *x, const float *y, const float *z, int count, float *out,
+                             float *gradX, float *gradY, float *gradZ) {
+        if (basis == NoiseBasis::SIMPLEX) {
+            SimplexKernel::heightPoints(table, octaves, x, y, z, count, out, gradX, gradY, gradZ);
+            return;
+        }
+        for (int i = 0; i < count; ++i) {
+            float g[3];
+            out[i] = PerlinKernel::height(table, octaves, x[i], y[i], z[i], g);
+            gradX[i] = g[0];
+            gradY[i] = g[1];
+            gradZ[i] = g[2];
+        }
+    };
+
+    // Height and extra channels in one pass, see PerlinKernel::channelPoints()
+    static void channelPoints(NoiseBasis basis, const NoiseTable &table, const Octaves &octaves, int channels,
+                              int channelOctaves, const float *x, const float *y, const float *z, int count,
+                              float *const *out) {
+        switch (basis) {
+            case NoiseBasis::SIMPLEX:
+                return SimplexKernel::channelPoints(table, octaves, channels, channelOctaves, x, y, z, count, out);
+            default: return PerlinKernel::channelPoints(table, octaves, channels, channelOctaves, x, y, z, count, out);
+        }
+    };
+
+    static const char *name(NoiseBasis basis) {
+        return basis == NoiseBasis::SIMPLEX ? "simplex" : "perlin";
+    };
+};
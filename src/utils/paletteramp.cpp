@@ -0,0 +1,50 @@
+#include "utils/paletteramp.h"
+
+#include <algorithm>
+#include <cstring>
+
+PaletteRamp PaletteRamp::compile(const std::vector<glm::vec3> &palette) {
+    PaletteRamp ramp;
+    for (int i = 0; i < SIZE; ++i) {
+        float height = MIN_HEIGHT + i / SCALE;
+        auto c = glm::clamp(blend(palette, height), 0.f, 1.f) * 255.f + 0.5f;
+        std::uint8_t texel[4] = {(std::uint8_t)c.x, (std::uint8_t)c.y, (std::uint8_t)c.z, 255};
+        std::memcpy(&ramp.texels[i], texel, 4);
+    }
+    return ramp;
+}
+
+glm::vec3 PaletteRamp::blend(const std::vector<glm::vec3> &palette, float height) {
+    if (height >= THRESHOLDS[0]) {
+        return palette[3];
+    }
+    else if (height >= THRESHOLDS[1]) {
+        auto a = (height-THRESHOLDS[1])/(THRESHOLDS[0]-THRESHOLDS[1]);
+        return glm::mix(palette[2], palette[3], a);
+    }
+    else if (height >= THRESHOLDS[2]) {
+        return palette[2];
+    }
+    else if (height >= THRESHOLDS[3]) {
+        auto a = (height-THRESHOLDS[3])/(THRESHOLDS[2]-THRESHOLDS[3]);
+        return glm::mix(palette[1], palette[2], a);
+    }
+    else if (height >= THRESHOLDS[4]) {
+        return palette[1];
+    }
+    else if (height >= THRESHOLDS[5]) {
+        auto a = (height-THRESHOLDS[5])/(THRESHOLDS[4]-THRESHOLDS[5]);
+        return glm::mix(palette[0], palette[1], a);
+    }
+    return palette[0];
+}
+
+void PaletteRamp::sampleRow(const float *heights, int count, std::uint8_t *out) const {
+    // Indices first, in a loop the compiler can vectorize, then the loads
+    int indices[256];
+    for (int begin = 0; begin < count; begin += 256) {
+        int n = std::min(256, count - begin);
+        for (int i = 0; i < n; ++i) indices[i] = index(heights[begin + i]);
+        for (int i = 0; i < n; ++i) std::memcpy(out + (begin + i) * 4, &texels[indices[i]], 4);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "glm/glm.hpp"
+
+// A four-color terrain palette compiled into RGBA8 texels indexed by noise height. Heights outside
+// [MIN_HEIGHT, MAX_HEIGHT] take the lowest or highest color, so sampling is a multiply-add, a clamp
+// and a load, without branches. Immutable once compiled, so any number of threads can share one.
+struct PaletteRamp {
+    // Heights at which the palette's bands and blends meet, from the highest down: the top color
+    // above THRESHOLDS[0], blended into the next one down to THRESHOLDS[1], and so on
+    static constexpr float THRESHOLDS[6] = {0.05f, 0.04f, 0.02f, 0.01f, -0.01f, -0.015f};
+
+    static constexpr int SIZE = 4096;
+    static constexpr float MIN_HEIGHT = THRESHOLDS[5];
+    static constexpr float MAX_HEIGHT = THRESHOLDS[0];
+    static constexpr float SCALE = (SIZE - 1) / (MAX_HEIGHT - MIN_HEIGHT);
+
+    std::array<std::uint32_t, SIZE> texels;     // RGBA8 in memory order
+
+    // Samples the palette's color bands and blends at every entry's height
+    static PaletteRamp compile(const std::vector<glm::vec3> &palette);
+
+    // Color of a height as blended from the palette before quantization
+    static glm::vec3 blend(const std::vector<glm::vec3> &palette, float height);
+
+    static int index(float height) {
+        return int(glm::clamp((height - MIN_HEIGHT) * SCALE + 0.5f, 0.f, float(SIZE - 1)));
+    };
+
+    std::uint32_t sample(float height) const { return texels[index(height)]; };
+
+    // out[i] = sample(heights[i]) for i in [0, count); out needs no alignment
+    void sampleRow(const float *heights, int count, std::uint8_t *out) const;
+};
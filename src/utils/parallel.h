@@ -0,0 +1,25 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Runs fn(i) for every i in [0, count) on `threads` threads (all hardware threads if 0) and
+// returns once every call has finished. Indices are handed out one at a time from a shared
+// counter, so items of uneven cost balance themselves across the threads.
+inline void parallelFor(int count, const std::function<void(int)> &fn, int threads = 0) {
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, count);
+
+    std::atomic<int> next = 0;
+    auto worker = [&]() {
+        for (int i = next++; i < count; i = next++) fn(i);
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &t: pool) t.join();
+}
@@ -0,0 +1,579 @@
+#include "utils/perlinkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define PERLIN_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define PERLIN_TARGET_AVX2
+#else
+#define PERLIN_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+Octaves Octaves::fixed() {
+    Octaves octaves;
+    for (float f: {2.f, 4.f, 8.f, 16.f}) {
+        octaves.freq[octaves.count] = f;
+        octaves.amp[octaves.count] = 1.f / f;
+        octaves.count += 1;
+    }
+    return octaves;
+}
+
+Octaves Octaves::forSpacing(float spacing) {
+    Octaves octaves;
+    for (float f = 2.f; octaves.count < MAX_COUNT; f *= 2) {
+        // Samples per lattice cell; at 4 and above the octave is kept whole
+        float samples = 1.f / (f * spacing);
+        float fade = std::min(std::max((samples - 2.f) / 2.f, 0.f), 1.f);
+        if (fade == 0.f) break;
+
+        octaves.freq[octaves.count] = f;
+        octaves.amp[octaves.count] = fade / f;
+        octaves.count += 1;
+    }
+    return octaves;
+}
+
+void NoiseTable::randomize(unsigned int seed) {
+    std::mt19937 mt(seed);
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+
+    gradX.resize(SIZE);
+    gradY.resize(SIZE);
+    for (int i = 0; i < SIZE; i++) {
+        // Keep the draw order of the old vec2 lookup: x then y
+        gradX[i] = dist(mt);
+        gradY[i] = dist(mt);
+    }
+
+    // Drawn after the 2D gradients so that those stay what they were
+    gradZ.resize(SIZE);
+    for (int i = 0; i < SIZE; i++) {
+        gradZ[i] = dist(mt);
+    }
+}
+
+// Smoothstep easing, 3a^2 - 2a^3
+static inline float ease(float a) {
+    return a * a * (3.f - 2.f * a);
+}
+
+float PerlinKernel::perlin(const NoiseTable &table, float x, float y) {
+    return perlinWrapped(table, x, y, -1);
+}
+
+float PerlinKernel::perlinWrapped(const NoiseTable &table, float x, float y, int wrapMask) {
+    int base_x = (int)std::floor(x);
+    int base_y = (int)std::floor(y);
+    float fx = x - base_x;
+    float fy = y - base_y;
+
+    int tl = table.hash(base_x, base_y & wrapMask);
+    int tr = table.hash(base_x + 1, base_y & wrapMask);
+    int bl = table.hash(base_x, (base_y + 1) & wrapMask);
+    int br = table.hash(base_x + 1, (base_y + 1) & wrapMask);
+
+    float dot_tl = table.gradX[tl] * fx + table.gradY[tl] * fy;
+    float dot_tr = table.gradX[tr] * (fx - 1) + table.gradY[tr] * fy;
+    float dot_bl = table.gradX[bl] * fx + table.gradY[bl] * (fy - 1);
+    float dot_br = table.gradX[br] * (fx - 1) + table.gradY[br] * (fy - 1);
+
+    float ex = ease(fx);
+    float G = dot_tl + ex * (dot_tr - dot_tl);
+    float H = dot_bl + ex * (dot_br - dot_bl);
+    return G + ease(fy) * (H - G);
+}
+
+float PerlinKernel::perlin(const NoiseTable &table, float x, float y, float z) {
+    int base_x = (int)std::floor(x);
+    int base_y = (int)std::floor(y);
+    int base_z = (int)std::floor(z);
+    float fx = x - base_x;
+    float fy = y - base_y;
+    float fz = z - base_z;
+
+    // Dot products with the gradients of the eight cell corners, blended along x, then y, then z
+    float layers[2];
+    for (int k = 0; k < 2; ++k) {
+        float dz = fz - k;
+        float rows[2];
+        for (int j = 0; j < 2; ++j) {
+            float dy = fy - j;
+            int g0 = table.hash(base_x, base_y + j, base_z + k);
+            int g1 = table.hash(base_x + 1, base_y + j, base_z + k);
+            float d0 = table.gradX[g0] * fx + table.gradY[g0] * dy + table.gradZ[g0] * dz;
+            float d1 = table.gradX[g1] * (fx - 1) + table.gradY[g1] * dy + table.gradZ[g1] * dz;
+            rows[j] = d0 + ease(fx) * (d1 - d0);
+        }
+        layers[k] = rows[0] + ease(fy) * (rows[1] - rows[0]);
+    }
+    return layers[0] + ease(fz) * (layers[1] - layers[0]);
+}
+
+float PerlinKernel::height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z) {
+    float h = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        float f = octaves.freq[o];
+        h += octaves.amp[o] * perlin(table, x * f, y * f, z * f);
+    }
+    return h;
+}
+
+// Derivative of ease(), 6a - 6a^2
+static inline float easeDerivative(float a) {
+    return 6.f * a * (1.f - a);
+}
+
+float PerlinKernel::perlin(const NoiseTable &table, float x, float y, float z, float grad[3]) {
+    int base_x = (int)std::floor(x);
+    int base_y = (int)std::floor(y);
+    int base_z = (int)std::floor(z);
+    float fx = x - base_x;
+    float fy = y - base_y;
+    float fz = z - base_z;
+    float ex = ease(fx), ey = ease(fy), ez = ease(fz);
+
+    // The blends of perlin() carried out on the value and its three partial derivatives together.
+    // A corner's dot product changes along each axis by its gradient's component, and each blend
+    // adds the slope of its ease times the difference it blends across.
+    struct Sample { float v, dx, dy, dz; };
+    auto blend = [](const Sample &a, const Sample &b, float e) {
+        return Sample { a.v + e * (b.v - a.v), a.dx + e * (b.dx - a.dx),
+                        a.dy + e * (b.dy - a.dy), a.dz + e * (b.dz - a.dz) };
+    };
+    Sample layers[2];
+    for (int k = 0; k < 2; ++k) {
+        float dz = fz - k;
+        Sample rows[2];
+        for (int j = 0; j < 2; ++j) {
+            float dy = fy - j;
+            int g0 = table.hash(base_x, base_y + j, base_z + k);
+            int g1 = table.hash(base_x + 1, base_y + j, base_z + k);
+            Sample c0 { table.gradX[g0] * fx + table.gradY[g0] * dy + table.gradZ[g0] * dz,
+                        table.gradX[g0], table.gradY[g0], table.gradZ[g0] };
+            Sample c1 { table.gradX[g1] * (fx - 1) + table.gradY[g1] * dy + table.gradZ[g1] * dz,
+                        table.gradX[g1], table.gradY[g1], table.gradZ[g1] };
+            rows[j] = blend(c0, c1, ex);
+            rows[j].dx += easeDerivative(fx) * (c1.v - c0.v);
+        }
+        layers[k] = blend(rows[0], rows[1], ey);
+        layers[k].dy += easeDerivative(fy) * (rows[1].v - rows[0].v);
+    }
+    Sample n = blend(layers[0], layers[1], ez);
+    n.dz += easeDerivative(fz) * (layers[1].v - layers[0].v);
+    grad[0] = n.dx;
+    grad[1] = n.dy;
+    grad[2] = n.dz;
+    return n.v;
+}
+
+float PerlinKernel::height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z, float grad[3]) {
+    float h = 0.f;
+    grad[0] = grad[1] = grad[2] = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        float f = octaves.freq[o], g[3];
+        h += octaves.amp[o] * perlin(table, x * f, y * f, z * f, g);
+        for (int c = 0; c < 3; ++c) grad[c] += octaves.amp[o] * f * g[c];
+    }
+    return h;
+}
+
+void PerlinKernel::perlinChannels(const NoiseTable &table, float x, float y, float z, int channels, float *out) {
+    int base_x = (int)std::floor(x);
+    int base_y = (int)std::floor(y);
+    int base_z = (int)std::floor(z);
+    float fx = x - base_x;
+    float fy = y - base_y;
+    float fz = z - base_z;
+
+    // perlin() per channel, with the corner hashes and blend weights computed once
+    float layers[2][NoiseTable::MAX_CHANNELS];
+    for (int k = 0; k < 2; ++k) {
+        float dz = fz - k;
+        float rows[2][NoiseTable::MAX_CHANNELS];
+        for (int j = 0; j < 2; ++j) {
+            float dy = fy - j;
+            int h0 = table.hash(base_x, base_y + j, base_z + k);
+            int h1 = table.hash(base_x + 1, base_y + j, base_z + k);
+            for (int c = 0; c < channels; ++c) {
+                int g0 = table.channelHash(h0, c), g1 = table.channelHash(h1, c);
+                float d0 = table.gradX[g0] * fx + table.gradY[g0] * dy + table.gradZ[g0] * dz;
+                float d1 = table.gradX[g1] * (fx - 1) + table.gradY[g1] * dy + table.gradZ[g1] * dz;
+                rows[j][c] = d0 + ease(fx) * (d1 - d0);
+            }
+        }
+        for (int c = 0; c < channels; ++c) layers[k][c] = rows[0][c] + ease(fy) * (rows[1][c] - rows[0][c]);
+    }
+    for (int c = 0; c < channels; ++c) out[c] = layers[0][c] + ease(fz) * (layers[1][c] - layers[0][c]);
+}
+
+void PerlinKernel::channelPoints(const NoiseTable &table, const Octaves &octaves, int channels, int channelOctaves,
+                                 const float *x, const float *y, const float *z, int count, float *const *out) {
+    for (int i = 0; i < count; ++i) {
+        float h[NoiseTable::MAX_CHANNELS] = {};
+        for (int o = 0; o < octaves.count; ++o) {
+            float f = octaves.freq[o], n[NoiseTable::MAX_CHANNELS];
+            int active = o < channelOctaves ? channels : 1;
+            perlinChannels(table, x[i] * f, y[i] * f, z[i] * f, active, n);
+            for (int c = 0; c < active; ++c) h[c] += octaves.amp[o] * n[c];
+        }
+        for (int c = 0; c < channels; ++c) out[c][i] = h[c];
+    }
+}
+
+#ifdef PERLIN_X86
+
+PERLIN_TARGET_AVX2
+static inline __m256 easeAVX2(__m256 a) {
+    return _mm256_mul_ps(_mm256_mul_ps(a, a), _mm256_sub_ps(_mm256_set1_ps(3.f), _mm256_mul_ps(_mm256_set1_ps(2.f), a)));
+}
+
+PERLIN_TARGET_AVX2
+static inline __m256 lerpAVX2(__m256 a, __m256 b, __m256 t) {
+    return _mm256_add_ps(a, _mm256_mul_ps(t, _mm256_sub_ps(b, a)));
+}
+
+PERLIN_TARGET_AVX2
+static inline __m256 gradientDotAVX2(const NoiseTable &table, __m256i g, __m256 dx, __m256 dy, __m256 dz) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(table.gradX.data(), g, 4), dx),
+                                       _mm256_mul_ps(_mm256_i32gather_ps(table.gradY.data(), g, 4), dy)),
+                         _mm256_mul_ps(_mm256_i32gather_ps(table.gradZ.data(), g, 4), dz));
+}
+
+// Adds octaves O and up of PerlinKernel::unrolledChannels() at eight points to sums, one instance
+// per octave so that the whole sum unrolls; the operations of perlinChannels(), eight lanes wide
+template <int O, int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+PERLIN_TARGET_AVX2
+static inline void addOctavesAVX2(const NoiseTable &table, const Octaves &octaves, __m256 px, __m256 py, __m256 pz,
+                                  __m256 *sums) {
+    if constexpr (O < OCTAVES) {
+        constexpr int active = O < CHANNEL_OCTAVES ? CHANNELS : 1;
+        const __m256i mask = _mm256_set1_epi32(NoiseTable::MASK);
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 v_freq = _mm256_set1_ps(octaves.freq[O]);
+        __m256 x = _mm256_mul_ps(px, v_freq), y = _mm256_mul_ps(py, v_freq), z = _mm256_mul_ps(pz, v_freq);
+
+        __m256 floor_x = _mm256_floor_ps(x), floor_y = _mm256_floor_ps(y), floor_z = _mm256_floor_ps(z);
+        __m256 fx = _mm256_sub_ps(x, floor_x), fy = _mm256_sub_ps(y, floor_y), fz = _mm256_sub_ps(z, floor_z);
+        __m256 fx1 = _mm256_sub_ps(fx, one);
+        __m256i corner = _mm256_add_epi32(
+            _mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvtps_epi32(floor_x), _mm256_set1_epi32(41)),
+                             _mm256_mullo_epi32(_mm256_cvtps_epi32(floor_y), _mm256_set1_epi32(43))),
+            _mm256_mullo_epi32(_mm256_cvtps_epi32(floor_z), _mm256_set1_epi32(47)));
+        __m256 ex = easeAVX2(fx), ey = easeAVX2(fy), ez = easeAVX2(fz);
+
+        __m256 layers[2][active];
+        for (int k = 0; k < 2; ++k) {
+            __m256 dz = _mm256_sub_ps(fz, _mm256_set1_ps(float(k)));
+            __m256 rows[2][active];
+            for (int j = 0; j < 2; ++j) {
+                __m256 dy = _mm256_sub_ps(fy, _mm256_set1_ps(float(j)));
+                __m256i h0 = _mm256_and_si256(_mm256_add_epi32(corner, _mm256_set1_epi32(j * 43 + k * 47)), mask);
+                __m256i h1 = _mm256_and_si256(_mm256_add_epi32(corner, _mm256_set1_epi32(41 + j * 43 + k * 47)), mask);
+                for (int c = 0; c < active; ++c) {
+                    __m256i offset = _mm256_set1_epi32(c * NoiseTable::CHANNEL_OFFSET);
+                    __m256 d0 = gradientDotAVX2(table, _mm256_and_si256(_mm256_add_epi32(h0, offset), mask), fx, dy, dz);
+                    __m256 d1 = gradientDotAVX2(table, _mm256_and_si256(_mm256_add_epi32(h1, offset), mask), fx1, dy, dz);
+                    rows[j][c] = lerpAVX2(d0, d1, ex);
+                }
+            }
+            for (int c = 0; c < active; ++c) layers[k][c] = lerpAVX2(rows[0][c], rows[1][c], ey);
+        }
+        const __m256 v_amp = _mm256_set1_ps(octaves.amp[O]);
+        for (int c = 0; c < active; ++c) {
+            sums[c] = _mm256_add_ps(sums[c], _mm256_mul_ps(v_amp, lerpAVX2(layers[0][c], layers[1][c], ez)));
+        }
+        addOctavesAVX2<O + 1, OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, px, py, pz, sums);
+    }
+}
+
+// Whole batches of eight points of PerlinKernel::unrolledChannels(), returning how many points
+// that covers
+template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+PERLIN_TARGET_AVX2
+static int unrolledChannelsAVX2(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                const float *z, int count, float *const *out) {
+    int n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m256 sums[CHANNELS];
+        for (auto &sum: sums) sum = _mm256_setzero_ps();
+        addOctavesAVX2<0, OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, _mm256_loadu_ps(x + n),
+                                                              _mm256_loadu_ps(y + n), _mm256_loadu_ps(z + n), sums);
+        for (int c = 0; c < CHANNELS; ++c) _mm256_storeu_ps(out[c] + n, sums[c]);
+    }
+    return n;
+}
+
+#endif
+
+template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+void PerlinKernel::unrolledChannels(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                    const float *z, int count, float *const *out) {
+    int i = 0;
+#ifdef PERLIN_X86
+    if (hasAVX2()) i = unrolledChannelsAVX2<OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, x, y, z, count, out);
+#endif
+    for (; i < count; ++i) {
+        float h[CHANNELS] = {};
+        [&]<int... O>(std::integer_sequence<int, O...>) {
+            ([&] {
+                constexpr int active = O < CHANNEL_OCTAVES ? CHANNELS : 1;
+                float f = octaves.freq[O], n[NoiseTable::MAX_CHANNELS];
+                perlinChannels(table, x[i] * f, y[i] * f, z[i] * f, active, n);
+                for (int c = 0; c < active; ++c) h[c] += octaves.amp[O] * n[c];
+            }(), ...);
+        }(std::make_integer_sequence<int, OCTAVES>());
+        for (int c = 0; c < CHANNELS; ++c) out[c][i] = h[c];
+    }
+}
+
+template <int CHANNELS, int CHANNEL_OCTAVES>
+NoisePointsKernel PerlinKernel::unrolledPoints(int octaves) {
+    return [&]<int... O>(std::integer_sequence<int, O...>) {
+        static const NoisePointsKernel kernels[] = { &unrolledChannels<O, CHANNELS, CHANNEL_OCTAVES>... };
+        return kernels[octaves];
+    }(std::make_integer_sequence<int, Octaves::MAX_COUNT + 1>());
+}
+
+// Suns: heights alone
+template NoisePointsKernel PerlinKernel::unrolledPoints<1, 0>(int octaves);
+
+void PerlinKernel::octaveRowScalar(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                   float freq, float amp, float *out) {
+    for (int i = 0; i < count; ++i) {
+        out[i] += amp * perlinWrapped(table, x * freq, float(col0 + i) * dz * freq, wrapMask);
+    }
+}
+
+#ifdef PERLIN_X86
+
+void PerlinKernel::octaveRowSSE2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                 float freq, float amp, float *out) {
+    // Everything that depends on the row only is a scalar broadcast
+    float px = x * freq;
+    int base_x = (int)std::floor(px);
+    float fx = px - base_x;
+    float ex = ease(fx);
+    int row_hash = base_x * 41;
+
+    const float *gx = table.gradX.data();
+    const float *gy = table.gradY.data();
+    const __m128i mask = _mm_set1_epi32(NoiseTable::MASK);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 three = _mm_set1_ps(3.f);
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 v_fx = _mm_set1_ps(fx);
+    const __m128 v_fx1 = _mm_set1_ps(fx - 1);
+    const __m128 v_ex = _mm_set1_ps(ex);
+    const __m128 v_amp = _mm_set1_ps(amp);
+    const __m128 v_freq = _mm_set1_ps(freq);
+    const __m128 v_dz = _mm_set1_ps(dz);
+    const __m128i row0 = _mm_set1_epi32(row_hash);
+    const __m128i row1 = _mm_set1_epi32(row_hash + 41);
+    const __m128i v_one = _mm_set1_epi32(1);
+    const __m128i wrap = _mm_set1_epi32(wrapMask);
+
+    alignas(16) int idx[4][4];
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 lane = _mm_cvtepi32_ps(_mm_setr_epi32(col0 + i, col0 + i + 1, col0 + i + 2, col0 + i + 3));
+        __m128 pz = _mm_mul_ps(_mm_mul_ps(lane, v_dz), v_freq);
+
+        // floor() without SSE4.1: truncate, then step down where truncation rounded up
+        __m128i trunc = _mm_cvttps_epi32(pz);
+        __m128 up = _mm_cmpgt_ps(_mm_cvtepi32_ps(trunc), pz);
+        __m128i base_z = _mm_add_epi32(trunc, _mm_castps_si128(up));
+        __m128 fz = _mm_sub_ps(pz, _mm_cvtepi32_ps(base_z));
+        __m128 fz1 = _mm_sub_ps(fz, one);
+
+        // 43 * column without SSE4.1's mullo: 32 + 8 + 2 + 1
+        auto times43 = [](__m128i v) {
+            return _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(v, 5), _mm_slli_epi32(v, 3)),
+                                 _mm_add_epi32(_mm_slli_epi32(v, 1), v));
+        };
+        __m128i col = times43(_mm_and_si128(base_z, wrap));
+        __m128i col_next = times43(_mm_and_si128(_mm_add_epi32(base_z, v_one), wrap));
+        _mm_store_si128((__m128i *)idx[0], _mm_and_si128(_mm_add_epi32(row0, col), mask));
+        _mm_store_si128((__m128i *)idx[1], _mm_and_si128(_mm_add_epi32(row1, col), mask));
+        _mm_store_si128((__m128i *)idx[2], _mm_and_si128(_mm_add_epi32(row0, col_next), mask));
+        _mm_store_si128((__m128i *)idx[3], _mm_and_si128(_mm_add_epi32(row1, col_next), mask));
+
+        // tl, tr, bl, br
+        __m128 dots[4];
+        for (int c = 0; c < 4; ++c) {
+            const int *k = idx[c];
+            __m128 gxs = _mm_setr_ps(gx[k[0]], gx[k[1]], gx[k[2]], gx[k[3]]);
+            __m128 gys = _mm_setr_ps(gy[k[0]], gy[k[1]], gy[k[2]], gy[k[3]]);
+            __m128 ox = (c & 1) ? v_fx1 : v_fx;
+            __m128 oz = (c & 2) ? fz1 : fz;
+            dots[c] = _mm_add_ps(_mm_mul_ps(gxs, ox), _mm_mul_ps(gys, oz));
+        }
+
+        __m128 G = _mm_add_ps(dots[0], _mm_mul_ps(v_ex, _mm_sub_ps(dots[1], dots[0])));
+        __m128 H = _mm_add_ps(dots[2], _mm_mul_ps(v_ex, _mm_sub_ps(dots[3], dots[2])));
+        __m128 ez = _mm_mul_ps(_mm_mul_ps(fz, fz), _mm_sub_ps(three, _mm_mul_ps(two, fz)));
+        __m128 noise = _mm_add_ps(G, _mm_mul_ps(ez, _mm_sub_ps(H, G)));
+
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(v_amp, noise)));
+    }
+
+    for (; i < count; ++i) {
+        out[i] += amp * perlinWrapped(table, px, float(col0 + i) * dz * freq, wrapMask);
+    }
+}
+
+PERLIN_TARGET_AVX2
+void PerlinKernel::octaveRowAVX2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                 float freq, float amp, float *out) {
+    float px = x * freq;
+    int base_x = (int)std::floor(px);
+    float fx = px - base_x;
+    float ex = ease(fx);
+    int row_hash = base_x * 41;
+
+    const float *gx = table.gradX.data();
+    const float *gy = table.gradY.data();
+    const __m256i mask = _mm256_set1_epi32(NoiseTable::MASK);
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 three = _mm256_set1_ps(3.f);
+    const __m256 two = _mm256_set1_ps(2.f);
+    const __m256 v_fx = _mm256_set1_ps(fx);
+    const __m256 v_fx1 = _mm256_set1_ps(fx - 1);
+    const __m256 v_ex = _mm256_set1_ps(ex);
+    const __m256 v_amp = _mm256_set1_ps(amp);
+    const __m256 v_freq = _mm256_set1_ps(freq);
+    const __m256 v_dz = _mm256_set1_ps(dz);
+    const __m256i row0 = _mm256_set1_epi32(row_hash);
+    const __m256i row1 = _mm256_set1_epi32(row_hash + 41);
+    const __m256i col_mul = _mm256_set1_epi32(43);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i v_one = _mm256_set1_epi32(1);
+    const __m256i wrap = _mm256_set1_epi32(wrapMask);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 lane = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(col0 + i), lanes));
+        __m256 pz = _mm256_mul_ps(_mm256_mul_ps(lane, v_dz), v_freq);
+
+        __m256 floor_z = _mm256_floor_ps(pz);
+        __m256i base_z = _mm256_cvtps_epi32(floor_z);
+        __m256 fz = _mm256_sub_ps(pz, floor_z);
+        __m256 fz1 = _mm256_sub_ps(fz, one);
+
+        __m256i col = _mm256_mullo_epi32(_mm256_and_si256(base_z, wrap), col_mul);
+        __m256i col_next = _mm256_mullo_epi32(_mm256_and_si256(_mm256_add_epi32(base_z, v_one), wrap), col_mul);
+        __m256i tl = _mm256_and_si256(_mm256_add_epi32(row0, col), mask);
+        __m256i tr = _mm256_and_si256(_mm256_add_epi32(row1, col), mask);
+        __m256i bl = _mm256_and_si256(_mm256_add_epi32(row0, col_next), mask);
+        __m256i br = _mm256_and_si256(_mm256_add_epi32(row1, col_next), mask);
+
+        __m256 dot_tl = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(gx, tl, 4), v_fx),
+                                      _mm256_mul_ps(_mm256_i32gather_ps(gy, tl, 4), fz));
+        __m256 dot_tr = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(gx, tr, 4), v_fx1),
+                                      _mm256_mul_ps(_mm256_i32gather_ps(gy, tr, 4), fz));
+        __m256 dot_bl = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(gx, bl, 4), v_fx),
+                                      _mm256_mul_ps(_mm256_i32gather_ps(gy, bl, 4), fz1));
+        __m256 dot_br = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(gx, br, 4), v_fx1),
+                                      _mm256_mul_ps(_mm256_i32gather_ps(gy, br, 4), fz1));
+
+        __m256 G = _mm256_add_ps(dot_tl, _mm256_mul_ps(v_ex, _mm256_sub_ps(dot_tr, dot_tl)));
+        __m256 H = _mm256_add_ps(dot_bl, _mm256_mul_ps(v_ex, _mm256_sub_ps(dot_br, dot_bl)));
+        __m256 ez = _mm256_mul_ps(_mm256_mul_ps(fz, fz), _mm256_sub_ps(three, _mm256_mul_ps(two, fz)));
+        __m256 noise = _mm256_add_ps(G, _mm256_mul_ps(ez, _mm256_sub_ps(H, G)));
+
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(v_amp, noise)));
+    }
+
+    for (; i < count; ++i) {
+        out[i] += amp * perlinWrapped(table, px, float(col0 + i) * dz * freq, wrapMask);
+    }
+}
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+enum class PerlinISA { SCALAR, SSE2, AVX2 };
+
+static PerlinISA detectISA() {
+    static const PerlinISA isa = cpuHasAVX2() ? PerlinISA::AVX2 : PerlinISA::SSE2;
+    return isa;
+}
+
+#else
+
+void PerlinKernel::octaveRowSSE2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                 float freq, float amp, float *out) {
+    octaveRowScalar(table, x, col0, dz, count, wrapMask, freq, amp, out);
+}
+
+void PerlinKernel::octaveRowAVX2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                 float freq, float amp, float *out) {
+    octaveRowScalar(table, x, col0, dz, count, wrapMask, freq, amp, out);
+}
+
+enum class PerlinISA { SCALAR, SSE2, AVX2 };
+
+static PerlinISA detectISA() {
+    return PerlinISA::SCALAR;
+}
+
+#endif
+
+void PerlinKernel::heightRowScalar(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                                   int count, float *out) {
+    for (int i = 0; i < count; ++i) out[i] = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        octaveRowScalar(table, x, col0, dz, count, octaves.wrapMask(o), octaves.freq[o], octaves.amp[o], out);
+    }
+}
+
+void PerlinKernel::heightRow(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                             int count, float *out) {
+    auto isa = detectISA();
+    if (isa == PerlinISA::SCALAR) {
+        heightRowScalar(table, octaves, x, col0, dz, count, out);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) out[i] = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        if (isa == PerlinISA::AVX2) {
+            octaveRowAVX2(table, x, col0, dz, count, octaves.wrapMask(o), octaves.freq[o], octaves.amp[o], out);
+        } else {
+            octaveRowSSE2(table, x, col0, dz, count, octaves.wrapMask(o), octaves.freq[o], octaves.amp[o], out);
+        }
+    }
+}
+
+bool PerlinKernel::hasAVX2() {
+    return detectISA() == PerlinISA::AVX2;
+}
+
+const char *PerlinKernel::isa() {
+    switch (detectISA()) {
+        case PerlinISA::AVX2: return "avx2";
+        case PerlinISA::SSE2: return "sse2";
+        default: return "scalar";
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+
+// Lattice of random gradient vectors sampled by the Perlin kernels.
+// The gradients are stored as separate x/y arrays so that the SIMD path can gather them directly,
+// and the size is a fixed power of two so that hashing a lattice corner is a multiply-add and a
+// mask the kernels compile to an immediate.
+struct NoiseTable {
+    static constexpr int SIZE = 1024;
+    static constexpr int MASK = SIZE - 1;
+
+    std::vector<float> gradX;
+    std::vector<float> gradY;
+    std::vector<float> gradZ;   // only read by the 3D noise
+
+    // Fills the table with SIZE gradients in [-1, 1]^3
+    void randomize(unsigned int seed);
+
+    // Index of the gradient at lattice corner (row, col), or (row, col, layer) in 3D
+    int hash(int row, int col) const { return (row * 41 + col * 43) & MASK; };
+    int hash(int row, int col, int layer) const { return (row * 41 + col * 43 + layer * 47) & MASK; };
+
+    // Noise channels evaluated alongside the height (channel 0), e.g. a biome's temperature and
+    // moisture. Channel c reads the gradient at a corner's hash plus c * CHANNEL_OFFSET, which no
+    // lattice step of fewer than a dozen cells reaches, so every channel is an independent field
+    // that shares all of the height's lattice arithmetic.
+    static constexpr int MAX_CHANNELS = 3;
+    static constexpr int CHANNEL_OFFSET = 261;
+    int channelHash(int hash, int channel) const { return (hash + channel * CHANNEL_OFFSET) & MASK; };
+};
+
+// Octaves of a fractal noise sum: frequency doubles and amplitude halves each step, starting at
+// frequency 2. forSpacing() keeps only the octaves the sampling grid can resolve, fading each one
+// out analytically as its lattice cells shrink from 4 to 2 samples across (the Nyquist limit), so
+// finer grids get more detail and coarser grids skip the octaves that would only alias.
+struct Octaves {
+    static constexpr int MAX_COUNT = 12;   // enough for the finest virtual texture pages
+
+    int count = 0;
+    float freq[MAX_COUNT] = {};
+    float amp[MAX_COUNT] = {};
+
+    // The row kernels repeat along the column axis every `wrap` noise units, 0 for never. Must be
+    // a power of two, so that every octave's lattice wraps by masking its column index.
+    int wrap = 0;
+
+    // Mask for the lattice columns of octave o, all ones if the noise doesn't wrap
+    int wrapMask(int o) const { return wrap > 0 ? int(wrap * freq[o]) - 1 : -1; };
+
+    // The four octaves of TerrainGenerator::getHeight(), whatever the sampling grid
+    static Octaves fixed();
+
+    // Octaves for samples `spacing` noise units apart
+    static Octaves forSpacing(float spacing);
+};
+
+// A channelPoints() evaluator compiled for one number of octaves, channels and channel octaves,
+// see PerlinKernel::unrolledPoints()
+using NoisePointsKernel = void (*)(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                   const float *z, int count, float *const *out);
+
+// Batch evaluators for the fractal Perlin noise used by TerrainGenerator::getHeight().
+// A call evaluates one texture row at a time: the row coordinate x is fixed and the column
+// coordinate z advances by a constant step, so that the x half of every lattice lookup is shared.
+// Samples are placed at whole multiples of the step, so a texel has the same value whichever
+// row segment (e.g. a tile) it is evaluated in.
+class PerlinKernel {
+public:
+    // out[i] = height(x, (col0 + i) * dz) for i in [0, count), summed over the given octaves,
+    // using the widest instruction set available
+    static void heightRow(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                          int count, float *out);
+
+    // Scalar reference implementation of heightRow()
+    static void heightRowScalar(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                                int count, float *out);
+
+    // Single Perlin sample, the scalar kernel every other path has to match. The wrapped variant
+    // masks the lattice column (the y axis) with wrapMask, see Octaves::wrap.
+    static float perlin(const NoiseTable &table, float x, float y);
+    static float perlinWrapped(const NoiseTable &table, float x, float y, int wrapMask);
+
+    // 3D gradient noise, and its fractal sum over the given octaves
+    static float perlin(const NoiseTable &table, float x, float y, float z);
+    static float height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z);
+
+    // The same, also writing the partial derivatives along x, y and z to grad, in one evaluation
+    // of the lattice. The value matches the overloads above exactly.
+    static float perlin(const NoiseTable &table, float x, float y, float z, float grad[3]);
+    static float height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z, float grad[3]);
+
+    // out[c][i] for c in [0, channels) and i in [0, count): channel c of the fractal noise at
+    // (x[i], y[i], z[i]). Channel 0 is height() over all octaves, the others only sum the first
+    // channelOctaves, and every lattice cell is hashed once for all channels. Scalar, the
+    // reference for unrolledPoints().
+    static void channelPoints(const NoiseTable &table, const Octaves &octaves, int channels, int channelOctaves,
+                              const float *x, const float *y, const float *z, int count, float *const *out);
+
+    // channelPoints() of CHANNELS channels, the extra ones over the first CHANNEL_OCTAVES octaves,
+    // compiled for `octaves` octaves (up to Octaves::MAX_COUNT) with the octave loop unrolled. It
+    // takes the frequencies and amplitudes of the first `octaves` octaves of its argument, whose
+    // count it ignores, and matches channelPoints() exactly. With AVX2, batches of eight points run
+    // through all octaves with their sums in registers. Instantiated for the channel layouts of
+    // TerrainPipeline's planet types.
+    template <int CHANNELS, int CHANNEL_OCTAVES>
+    static NoisePointsKernel unrolledPoints(int octaves);
+
+    // Name of the instruction set heightRow() dispatches to ("avx2", "sse2" or "scalar")
+    static const char *isa();
+
+    // Whether the CPU runs AVX2, detected once and shared with the other noise kernels
+    static bool hasAVX2();
+
+private:
+    // 3D noise of the first `channels` channels at one point, out[0] being perlin()
+    static void perlinChannels(const NoiseTable &table, float x, float y, float z, int channels, float *out);
+
+    template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+    static void unrolledChannels(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                 const float *z, int count, float *const *out);
+
+    static void octaveRowScalar(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                                float freq, float amp, float *out);
+    static void octaveRowSSE2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                              float freq, float amp, float *out);
+    static void octaveRowAVX2(const NoiseTable &table, float x, int col0, float dz, int count, int wrapMask,
+                              float freq, float amp, float *out);
+};
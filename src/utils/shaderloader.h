@@ -8,13 +8,17 @@
 #include <QFile>
 #include <QTextStream>
 #include <iostream>
+#include <string>
 
 class ShaderLoader{
 public:
-    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
+    // The fragment shader may share declarations and functions with others through a snippet
+    // file, whose code is inserted after the shader's #version line
+    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path,
+                                      const char * fragment_snippet_path = nullptr){
         // Create and compile the shaders.
         GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);
-        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragment_file_path);
+        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragment_file_path, fragment_snippet_path);
 
         // Link the shader program.
         GLuint programID = glCreateProgram();
@@ -45,20 +49,32 @@ public:
     }
 
 private:
-    static GLuint createShader(GLenum shaderType, const char *filepath){
-        GLuint shaderID = glCreateShader(shaderType);
-
-        // Read shader file.
-        std::string code;
+    static std::string readFile(const char *filepath){
         QString filepathStr = QString(filepath);
         QFile file(filepathStr);
 
         if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
             QTextStream stream(&file);
-            code = stream.readAll().toStdString();
+            return stream.readAll().toStdString();
         }else{
             throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
         }
+    }
+
+    static GLuint createShader(GLenum shaderType, const char *filepath, const char *snippetpath = nullptr){
+        GLuint shaderID = glCreateShader(shaderType);
+
+        // Read shader file.
+        std::string code = readFile(filepath);
+
+        // Insert the snippet after the #version line, and restore the file's line numbers after
+        // it so that compile errors still point into the file
+        if (snippetpath != nullptr) {
+            std::size_t version_end = code.rfind("#version", 0) == 0 ? code.find('\n') : std::string::npos;
+            std::size_t at = version_end == std::string::npos ? 0 : version_end + 1;
+            int line = at == 0 ? 1 : 2;
+            code.insert(at, readFile(snippetpath) + "\n#line " + std::to_string(line) + "\n");
+        }
 
         // Compile shader code.
         const char *codePtr = code.c_str();
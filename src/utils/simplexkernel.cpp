@@ -0,0 +1,572 @@
+#include "utils/simplexkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define SIMPLEX_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMPLEX_TARGET_AVX2
+#else
+#define SIMPLEX_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Skew and unskew factors between the unit square/cube lattice and the simplex lattice
+static const float F2 = 0.36602540f;   // (sqrt(3) - 1) / 2
+static const float G2 = 0.21132487f;   // (3 - sqrt(3)) / 6
+static const float F3 = 1.f / 3.f;
+static const float G3 = 1.f / 6.f;
+
+// Output scale, matched to the standard deviation of PerlinKernel::perlin() over the
+// same [-1, 1]^n gradient tables
+static const float SCALE_2D = 38.8f;
+static const float SCALE_3D = 19.4f;
+
+// floor() as an integer, without the libm call that SSE2 has no instruction for
+static inline int fastFloor(float x) {
+    int i = (int)x;
+    return i - (x < i);
+}
+
+float SimplexKernel::simplex(const NoiseTable &table, float x, float y) {
+    // Cell of the skewed lattice, then the triangle within it
+    float s = (x + y) * F2;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    float t = (i + j) * G2;
+    float x0 = x - (i - t);
+    float y0 = y - (j - t);
+    int i1 = x0 > y0;
+    int j1 = 1 - i1;
+
+    // Corners past the falloff radius contribute zero; clamping instead of branching keeps the
+    // unpredictable comparisons out of the pipeline
+    auto corner = [&](int g, float dx, float dy) {
+        float falloff = std::max(0.5f - dx * dx - dy * dy, 0.f);
+        falloff *= falloff;
+        return falloff * falloff * (table.gradX[g] * dx + table.gradY[g] * dy);
+    };
+    float n = corner(table.hash(i, j), x0, y0)
+            + corner(table.hash(i + i1, j + j1), x0 - i1 + G2, y0 - j1 + G2)
+            + corner(table.hash(i + 1, j + 1), x0 - 1 + 2 * G2, y0 - 1 + 2 * G2);
+    return SCALE_2D * n;
+}
+
+float SimplexKernel::simplex(const NoiseTable &table, float x, float y, float z) {
+    float s = (x + y + z) * F3;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    int k = fastFloor(z + s);
+    float t = (i + j + k) * G3;
+    float x0 = x - (i - t);
+    float y0 = y - (j - t);
+    float z0 = z - (k - t);
+
+    // The tetrahedron follows the order of the offsets along each axis: the second corner steps
+    // along the largest one, the third along the largest two
+    int i1 = x0 >= y0 && x0 >= z0;
+    int j1 = y0 > x0 && y0 >= z0;
+    int k1 = z0 > x0 && z0 > y0;
+    int i2 = x0 >= y0 || x0 >= z0;
+    int j2 = y0 > x0 || y0 >= z0;
+    int k2 = z0 > x0 || z0 > y0;
+
+    auto corner = [&](int g, float dx, float dy, float dz) {
+        float falloff = std::max(0.6f - dx * dx - dy * dy - dz * dz, 0.f);
+        falloff *= falloff;
+        return falloff * falloff * (table.gradX[g] * dx + table.gradY[g] * dy + table.gradZ[g] * dz);
+    };
+    float n = corner(table.hash(i, j, k), x0, y0, z0)
+            + corner(table.hash(i + i1, j + j1, k + k1), x0 - i1 + G3, y0 - j1 + G3, z0 - k1 + G3)
+            + corner(table.hash(i + i2, j + j2, k + k2), x0 - i2 + 2 * G3, y0 - j2 + 2 * G3, z0 - k2 + 2 * G3)
+            + corner(table.hash(i + 1, j + 1, k + 1), x0 - 1 + 3 * G3, y0 - 1 + 3 * G3, z0 - 1 + 3 * G3);
+    return SCALE_3D * n;
+}
+
+float SimplexKernel::height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z) {
+    float h = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        float f = octaves.freq[o];
+        h += octaves.amp[o] * simplex(table, x * f, y * f, z * f);
+    }
+    return h;
+}
+
+float SimplexKernel::simplex(const NoiseTable &table, float x, float y, float z, float grad[3]) {
+    float s = (x + y + z) * F3;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    int k = fastFloor(z + s);
+    float t = (i + j + k) * G3;
+    float x0 = x - (i - t);
+    float y0 = y - (j - t);
+    float z0 = z - (k - t);
+
+    int i1 = x0 >= y0 && x0 >= z0;
+    int j1 = y0 > x0 && y0 >= z0;
+    int k1 = z0 > x0 && z0 > y0;
+    int i2 = x0 >= y0 || x0 >= z0;
+    int j2 = y0 > x0 || y0 >= z0;
+    int k2 = z0 > x0 || z0 > y0;
+
+    // A corner contributes falloff^4 * dot(g, d) with falloff = 0.6 - |d|^2, so its derivative
+    // is falloff^4 * g - 8 * falloff^3 * dot(g, d) * d; every offset d moves with the sample
+    float dx = 0.f, dy = 0.f, dz = 0.f;
+    auto corner = [&](int g, float cx, float cy, float cz) {
+        float falloff = std::max(0.6f - cx * cx - cy * cy - cz * cz, 0.f);
+        float falloff2 = falloff * falloff;
+        float dot = table.gradX[g] * cx + table.gradY[g] * cy + table.gradZ[g] * cz;
+        float slope = 8.f * falloff2 * falloff * dot;
+        float falloff4 = falloff2 * falloff2;
+        dx += falloff4 * table.gradX[g] - slope * cx;
+        dy += falloff4 * table.gradY[g] - slope * cy;
+        dz += falloff4 * table.gradZ[g] - slope * cz;
+        return falloff4 * dot;
+    };
+    float n = corner(table.hash(i, j, k), x0, y0, z0)
+            + corner(table.hash(i + i1, j + j1, k + k1), x0 - i1 + G3, y0 - j1 + G3, z0 - k1 + G3)
+            + corner(table.hash(i + i2, j + j2, k + k2), x0 - i2 + 2 * G3, y0 - j2 + 2 * G3, z0 - k2 + 2 * G3)
+            + corner(table.hash(i + 1, j + 1, k + 1), x0 - 1 + 3 * G3, y0 - 1 + 3 * G3, z0 - 1 + 3 * G3);
+    grad[0] = SCALE_3D * dx;
+    grad[1] = SCALE_3D * dy;
+    grad[2] = SCALE_3D * dz;
+    return SCALE_3D * n;
+}
+
+float SimplexKernel::height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z, float grad[3]) {
+    float h = 0.f;
+    grad[0] = grad[1] = grad[2] = 0.f;
+    for (int o = 0; o < octaves.count; ++o) {
+        float f = octaves.freq[o], g[3];
+        h += octaves.amp[o] * simplex(table, x * f, y * f, z * f, g);
+        for (int c = 0; c < 3; ++c) grad[c] += octaves.amp[o] * f * g[c];
+    }
+    return h;
+}
+
+void SimplexKernel::heightPoints(const NoiseTable &table, const Octaves &octaves,
+                                 const float *x, const float *y, const float *z, int count, float *out) {
+    heightPoints(table, octaves, x, y, z, count, out, nullptr, nullptr, nullptr);
+}
+
+void SimplexKernel::heightPoints(const NoiseTable &table, const Octaves &octaves,
+                                 const float *x, const float *y, const float *z, int count, float *out,
+                                 float *gradX, float *gradY, float *gradZ) {
+    if (!PerlinKernel::hasAVX2()) {
+        for (int i = 0; i < count; ++i) {
+            if (gradX == nullptr) {
+                out[i] = height(table, octaves, x[i], y[i], z[i]);
+                continue;
+            }
+            float g[3];
+            out[i] = height(table, octaves, x[i], y[i], z[i], g);
+            gradX[i] = g[0];
+            gradY[i] = g[1];
+            gradZ[i] = g[2];
+        }
+        return;
+    }
+
+    std::fill(out, out + count, 0.f);
+    if (gradX != nullptr) {
+        std::fill(gradX, gradX + count, 0.f);
+        std::fill(gradY, gradY + count, 0.f);
+        std::fill(gradZ, gradZ + count, 0.f);
+    }
+    for (int o = 0; o < octaves.count; ++o) {
+        octavePointsAVX2(table, x, y, z, count, octaves.freq[o], octaves.amp[o], out, gradX, gradY, gradZ);
+    }
+}
+
+void SimplexKernel::heightRow(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                              int count, float *out) {
+    if (octaves.wrap == 0) {
+        for (int i = 0; i < count; ++i) out[i] = 0.f;
+        for (int o = 0; o < octaves.count; ++o) {
+            float f = octaves.freq[o], a = octaves.amp[o];
+            for (int i = 0; i < count; ++i) out[i] += a * simplex(table, x * f, float(col0 + i) * dz * f);
+        }
+        return;
+    }
+
+    std::vector<float> xs(count, x), ys(count), zs(count);
+    wrapColumns(octaves, col0, dz, count, ys.data(), zs.data());
+    heightPoints(table, octaves, xs.data(), ys.data(), zs.data(), count, out);
+}
+
+void SimplexKernel::wrapColumns(const Octaves &octaves, int col0, float dz, int count, float *y, float *z) {
+    // Column i sits at angle 2 * pi * z / wrap on a cylinder of circumference wrap, so that
+    // neighboring samples stay dz apart
+    float radius = octaves.wrap / (2 * 3.14159265f);
+    for (int i = 0; i < count; ++i) {
+        float angle = float(col0 + i) * dz / radius;
+        y[i] = radius * std::cos(angle);
+        z[i] = radius * std::sin(angle);
+    }
+}
+
+void SimplexKernel::octavePointsScalar(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                       int count, float freq, float amp, float *out,
+                                       float *gradX, float *gradY, float *gradZ) {
+    for (int n = 0; n < count; ++n) {
+        if (gradX == nullptr) {
+            out[n] += amp * simplex(table, x[n] * freq, y[n] * freq, z[n] * freq);
+            continue;
+        }
+        float g[3];
+        out[n] += amp * simplex(table, x[n] * freq, y[n] * freq, z[n] * freq, g);
+        gradX[n] += amp * freq * g[0];
+        gradY[n] += amp * freq * g[1];
+        gradZ[n] += amp * freq * g[2];
+    }
+}
+
+void SimplexKernel::simplexChannels(const NoiseTable &table, float x, float y, float z, int channels, float *out) {
+    float s = (x + y + z) * F3;
+    int i = fastFloor(x + s);
+    int j = fastFloor(y + s);
+    int k = fastFloor(z + s);
+    float t = (i + j + k) * G3;
+    float x0 = x - (i - t);
+    float y0 = y - (j - t);
+    float z0 = z - (k - t);
+
+    int i1 = x0 >= y0 && x0 >= z0;
+    int j1 = y0 > x0 && y0 >= z0;
+    int k1 = z0 > x0 && z0 > y0;
+    int i2 = x0 >= y0 || x0 >= z0;
+    int j2 = y0 > x0 || y0 >= z0;
+    int k2 = z0 > x0 || z0 > y0;
+
+    // The falloff of a corner only depends on its offset, so every channel shares it
+    float n[NoiseTable::MAX_CHANNELS] = {};
+    auto corner = [&](int h, float dx, float dy, float dz) {
+        float falloff = std::max(0.6f - dx * dx - dy * dy - dz * dz, 0.f);
+        falloff *= falloff;
+        for (int c = 0; c < channels; ++c) {
+            int g = table.channelHash(h, c);
+            n[c] += falloff * falloff * (table.gradX[g] * dx + table.gradY[g] * dy + table.gradZ[g] * dz);
+        }
+    };
+    corner(table.hash(i, j, k), x0, y0, z0);
+    corner(table.hash(i + i1, j + j1, k + k1), x0 - i1 + G3, y0 - j1 + G3, z0 - k1 + G3);
+    corner(table.hash(i + i2, j + j2, k + k2), x0 - i2 + 2 * G3, y0 - j2 + 2 * G3, z0 - k2 + 2 * G3);
+    corner(table.hash(i + 1, j + 1, k + 1), x0 - 1 + 3 * G3, y0 - 1 + 3 * G3, z0 - 1 + 3 * G3);
+    for (int c = 0; c < channels; ++c) out[c] = SCALE_3D * n[c];
+}
+
+void SimplexKernel::channelPointsScalar(const NoiseTable &table, const Octaves &octaves, int channels,
+                                        int channelOctaves, const float *x, const float *y, const float *z,
+                                        int count, float *const *out) {
+    for (int i = 0; i < count; ++i) {
+        float h[NoiseTable::MAX_CHANNELS] = {};
+        for (int o = 0; o < octaves.count; ++o) {
+            float f = octaves.freq[o], n[NoiseTable::MAX_CHANNELS];
+            int active = o < channelOctaves ? channels : 1;
+            simplexChannels(table, x[i] * f, y[i] * f, z[i] * f, active, n);
+            for (int c = 0; c < active; ++c) h[c] += octaves.amp[o] * n[c];
+        }
+        for (int c = 0; c < channels; ++c) out[c][i] = h[c];
+    }
+}
+
+void SimplexKernel::channelPoints(const NoiseTable &table, const Octaves &octaves, int channels, int channelOctaves,
+                                  const float *x, const float *y, const float *z, int count, float *const *out) {
+    if (!PerlinKernel::hasAVX2()) {
+        channelPointsScalar(table, octaves, channels, channelOctaves, x, y, z, count, out);
+        return;
+    }
+
+    for (int c = 0; c < channels; ++c) std::fill(out[c], out[c] + count, 0.f);
+    for (int o = 0; o < octaves.count; ++o) {
+        int active = o < channelOctaves ? channels : 1;
+        octaveChannelsAVX2(table, x, y, z, count, octaves.freq[o], octaves.amp[o], active, out);
+    }
+}
+
+#ifdef SIMPLEX_X86
+
+// The corners of the tetrahedra around eight samples, as in the scalar simplex(): their hashes
+// and the samples' offsets from them
+struct SimplexCellAVX2 {
+    __m256i hash[4];
+    __m256 dx[4], dy[4], dz[4];
+};
+
+SIMPLEX_TARGET_AVX2
+static inline __m256i hashStepAVX2(__m256 di, __m256 dj, __m256 dk) {
+    return _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(di), _mm256_set1_epi32(41)),
+                                             _mm256_mullo_epi32(_mm256_cvttps_epi32(dj), _mm256_set1_epi32(43))),
+                            _mm256_mullo_epi32(_mm256_cvttps_epi32(dk), _mm256_set1_epi32(47)));
+}
+
+// The tetrahedron and the falloff cutoff are selected by masks, with the same operations in the
+// same order as the scalar path, so that results match it bit for bit
+SIMPLEX_TARGET_AVX2
+static inline void simplexCellAVX2(__m256 px, __m256 py, __m256 pz, SimplexCellAVX2 &cell) {
+    const __m256 one = _mm256_set1_ps(1.f);
+    const __m256 g3 = _mm256_set1_ps(G3), g3x2 = _mm256_set1_ps(2 * G3), g3x3 = _mm256_set1_ps(3 * G3);
+
+    __m256 s = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(px, py), pz), _mm256_set1_ps(F3));
+    __m256i i = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(px, s)));
+    __m256i j = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(py, s)));
+    __m256i k = _mm256_cvttps_epi32(_mm256_floor_ps(_mm256_add_ps(pz, s)));
+    __m256 t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_add_epi32(i, j), k)), g3);
+    __m256 x0 = _mm256_sub_ps(px, _mm256_sub_ps(_mm256_cvtepi32_ps(i), t));
+    __m256 y0 = _mm256_sub_ps(py, _mm256_sub_ps(_mm256_cvtepi32_ps(j), t));
+    __m256 z0 = _mm256_sub_ps(pz, _mm256_sub_ps(_mm256_cvtepi32_ps(k), t));
+
+    __m256 x_ge_y = _mm256_cmp_ps(x0, y0, _CMP_GE_OQ), x_ge_z = _mm256_cmp_ps(x0, z0, _CMP_GE_OQ);
+    __m256 y_gt_x = _mm256_cmp_ps(y0, x0, _CMP_GT_OQ), y_ge_z = _mm256_cmp_ps(y0, z0, _CMP_GE_OQ);
+    __m256 z_gt_x = _mm256_cmp_ps(z0, x0, _CMP_GT_OQ), z_gt_y = _mm256_cmp_ps(z0, y0, _CMP_GT_OQ);
+    __m256 i1 = _mm256_and_ps(_mm256_and_ps(x_ge_y, x_ge_z), one);
+    __m256 j1 = _mm256_and_ps(_mm256_and_ps(y_gt_x, y_ge_z), one);
+    __m256 k1 = _mm256_and_ps(_mm256_and_ps(z_gt_x, z_gt_y), one);
+    __m256 i2 = _mm256_and_ps(_mm256_or_ps(x_ge_y, x_ge_z), one);
+    __m256 j2 = _mm256_and_ps(_mm256_or_ps(y_gt_x, y_ge_z), one);
+    __m256 k2 = _mm256_and_ps(_mm256_or_ps(z_gt_x, z_gt_y), one);
+
+    // Hashes of the corners: the base one plus each step's share of 41, 43 and 47
+    __m256i h0 = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(i, _mm256_set1_epi32(41)),
+                                                   _mm256_mullo_epi32(j, _mm256_set1_epi32(43))),
+                                  _mm256_mullo_epi32(k, _mm256_set1_epi32(47)));
+    cell.hash[0] = h0;
+    cell.hash[1] = _mm256_add_epi32(h0, hashStepAVX2(i1, j1, k1));
+    cell.hash[2] = _mm256_add_epi32(h0, hashStepAVX2(i2, j2, k2));
+    cell.hash[3] = _mm256_add_epi32(h0, _mm256_set1_epi32(41 + 43 + 47));
+
+    __m256 steps[4][3] = {{_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()},
+                          {i1, j1, k1}, {i2, j2, k2}, {one, one, one}};
+    __m256 shifts[4] = {_mm256_setzero_ps(), g3, g3x2, g3x3};
+    cell.dx[0] = x0;
+    cell.dy[0] = y0;
+    cell.dz[0] = z0;
+    for (int c = 1; c < 4; ++c) {
+        cell.dx[c] = _mm256_add_ps(_mm256_sub_ps(x0, steps[c][0]), shifts[c]);
+        cell.dy[c] = _mm256_add_ps(_mm256_sub_ps(y0, steps[c][1]), shifts[c]);
+        cell.dz[c] = _mm256_add_ps(_mm256_sub_ps(z0, steps[c][2]), shifts[c]);
+    }
+}
+
+// falloff^2 of the corners' offsets, clamped at the cutoff radius
+SIMPLEX_TARGET_AVX2
+static inline __m256 falloff2AVX2(__m256 dx, __m256 dy, __m256 dz, __m256 *falloff) {
+    __m256 f = _mm256_sub_ps(_mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.6f), _mm256_mul_ps(dx, dx)),
+                                           _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+    f = _mm256_max_ps(f, _mm256_setzero_ps());
+    if (falloff != nullptr) *falloff = f;
+    return _mm256_mul_ps(f, f);
+}
+
+// Dot product of the gradients at the (unmasked) hashes with the offsets
+SIMPLEX_TARGET_AVX2
+static inline __m256 gradientDotAVX2(const NoiseTable &table, __m256i h, __m256 dx, __m256 dy, __m256 dz,
+                                     __m256 *gradient) {
+    h = _mm256_and_si256(h, _mm256_set1_epi32(NoiseTable::MASK));
+    __m256 gx = _mm256_i32gather_ps(table.gradX.data(), h, 4);
+    __m256 gy = _mm256_i32gather_ps(table.gradY.data(), h, 4);
+    __m256 gz = _mm256_i32gather_ps(table.gradZ.data(), h, 4);
+    if (gradient != nullptr) {
+        gradient[0] = gx;
+        gradient[1] = gy;
+        gradient[2] = gz;
+    }
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, dx), _mm256_mul_ps(gy, dy)), _mm256_mul_ps(gz, dz));
+}
+
+SIMPLEX_TARGET_AVX2
+void SimplexKernel::octavePointsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                     int count, float freq, float amp, float *out,
+                                     float *gradX, float *gradY, float *gradZ) {
+    const __m256 v_freq = _mm256_set1_ps(freq);
+    const __m256 v_amp = _mm256_set1_ps(amp);
+    const __m256 v_scale = _mm256_set1_ps(SCALE_3D);
+    const __m256 v_slope = _mm256_set1_ps(amp * freq);     // chain rule through p * freq
+    float *grads[3] = { gradX, gradY, gradZ };
+
+    int n = 0;
+    for (; n + 8 <= count; n += 8) {
+        SimplexCellAVX2 cell;
+        simplexCellAVX2(_mm256_mul_ps(_mm256_loadu_ps(x + n), v_freq), _mm256_mul_ps(_mm256_loadu_ps(y + n), v_freq),
+                        _mm256_mul_ps(_mm256_loadu_ps(z + n), v_freq), cell);
+
+        // A corner contributes falloff^4 * dot, and falloff^4 * g - 8 * falloff^3 * dot * d to
+        // the derivatives
+        __m256 sum = _mm256_setzero_ps();
+        __m256 deriv[3] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+        for (int c = 0; c < 4; ++c) {
+            __m256 falloff, g[3];
+            __m256 falloff2 = falloff2AVX2(cell.dx[c], cell.dy[c], cell.dz[c], &falloff);
+            __m256 dot = gradientDotAVX2(table, cell.hash[c], cell.dx[c], cell.dy[c], cell.dz[c], g);
+            __m256 falloff4 = _mm256_mul_ps(falloff2, falloff2);
+            sum = c == 0 ? _mm256_mul_ps(falloff4, dot) : _mm256_add_ps(sum, _mm256_mul_ps(falloff4, dot));
+            if (gradX == nullptr) continue;
+
+            __m256 slope = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(8.f), falloff2), falloff), dot);
+            __m256 d[3] = { cell.dx[c], cell.dy[c], cell.dz[c] };
+            for (int a = 0; a < 3; ++a) {
+                deriv[a] = _mm256_add_ps(deriv[a], _mm256_sub_ps(_mm256_mul_ps(falloff4, g[a]), _mm256_mul_ps(slope, d[a])));
+            }
+        }
+
+        __m256 noise = _mm256_mul_ps(v_scale, sum);
+        _mm256_storeu_ps(out + n, _mm256_add_ps(_mm256_loadu_ps(out + n), _mm256_mul_ps(v_amp, noise)));
+        if (gradX == nullptr) continue;
+        for (int a = 0; a < 3; ++a) {
+            _mm256_storeu_ps(grads[a] + n, _mm256_add_ps(_mm256_loadu_ps(grads[a] + n),
+                                                         _mm256_mul_ps(v_slope, _mm256_mul_ps(v_scale, deriv[a]))));
+        }
+    }
+
+    octavePointsScalar(table, x + n, y + n, z + n, count - n, freq, amp, out + n,
+                       gradX ? gradX + n : nullptr, gradY ? gradY + n : nullptr, gradZ ? gradZ + n : nullptr);
+}
+
+SIMPLEX_TARGET_AVX2
+void SimplexKernel::octaveChannelsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                       int count, float freq, float amp, int channels, float *const *out) {
+    const __m256 v_freq = _mm256_set1_ps(freq);
+    const __m256 v_amp = _mm256_set1_ps(amp);
+    const __m256 v_scale = _mm256_set1_ps(SCALE_3D);
+    const __m256i v_offset = _mm256_set1_epi32(NoiseTable::CHANNEL_OFFSET);
+
+    int n = 0;
+    for (; n + 8 <= count; n += 8) {
+        SimplexCellAVX2 cell;
+        simplexCellAVX2(_mm256_mul_ps(_mm256_loadu_ps(x + n), v_freq), _mm256_mul_ps(_mm256_loadu_ps(y + n), v_freq),
+                        _mm256_mul_ps(_mm256_loadu_ps(z + n), v_freq), cell);
+
+        // One falloff per corner, one gather and dot product per corner and channel
+        __m256 sums[NoiseTable::MAX_CHANNELS];
+        for (int c = 0; c < 4; ++c) {
+            __m256 falloff2 = falloff2AVX2(cell.dx[c], cell.dy[c], cell.dz[c], nullptr);
+            __m256 falloff4 = _mm256_mul_ps(falloff2, falloff2);
+            __m256i h = cell.hash[c];
+            for (int ch = 0; ch < channels; ++ch) {
+                __m256 term = _mm256_mul_ps(falloff4, gradientDotAVX2(table, h, cell.dx[c], cell.dy[c], cell.dz[c], nullptr));
+                sums[ch] = c == 0 ? term : _mm256_add_ps(sums[ch], term);
+                h = _mm256_add_epi32(h, v_offset);
+            }
+        }
+        for (int ch = 0; ch < channels; ++ch) {
+            __m256 noise = _mm256_mul_ps(v_scale, sums[ch]);
+            _mm256_storeu_ps(out[ch] + n, _mm256_add_ps(_mm256_loadu_ps(out[ch] + n), _mm256_mul_ps(v_amp, noise)));
+        }
+    }
+
+    for (; n < count; ++n) {
+        float v[NoiseTable::MAX_CHANNELS];
+        simplexChannels(table, x[n] * freq, y[n] * freq, z[n] * freq, channels, v);
+        for (int ch = 0; ch < channels; ++ch) out[ch][n] += amp * v[ch];
+    }
+}
+
+#else
+
+void SimplexKernel::octavePointsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                     int count, float freq, float amp, float *out,
+                                     float *gradX, float *gradY, float *gradZ) {
+    octavePointsScalar(table, x, y, z, count, freq, amp, out, gradX, gradY, gradZ);
+}
+
+void SimplexKernel::octaveChannelsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                       int count, float freq, float amp, int channels, float *const *out) {
+    for (int n = 0; n < count; ++n) {
+        float v[NoiseTable::MAX_CHANNELS];
+        simplexChannels(table, x[n] * freq, y[n] * freq, z[n] * freq, channels, v);
+        for (int ch = 0; ch < channels; ++ch) out[ch][n] += amp * v[ch];
+    }
+}
+
+#endif
+
+#ifdef SIMPLEX_X86
+
+// Adds octaves O and up of SimplexKernel::unrolledChannels() at eight points to sums, one
+// instance per octave so that the whole sum unrolls
+template <int O, int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+SIMPLEX_TARGET_AVX2
+static inline void addOctavesAVX2(const NoiseTable &table, const Octaves &octaves, __m256 px, __m256 py, __m256 pz,
+                                  __m256 *sums) {
+    if constexpr (O < OCTAVES) {
+        constexpr int active = O < CHANNEL_OCTAVES ? CHANNELS : 1;
+        const __m256 v_freq = _mm256_set1_ps(octaves.freq[O]);
+        SimplexCellAVX2 cell;
+        simplexCellAVX2(_mm256_mul_ps(px, v_freq), _mm256_mul_ps(py, v_freq), _mm256_mul_ps(pz, v_freq), cell);
+
+        // The operations of octaveChannelsAVX2(), and of octavePointsAVX2() for one channel
+        __m256 terms[active];
+        for (int c = 0; c < 4; ++c) {
+            __m256 falloff2 = falloff2AVX2(cell.dx[c], cell.dy[c], cell.dz[c], nullptr);
+            __m256 falloff4 = _mm256_mul_ps(falloff2, falloff2);
+            __m256i h = cell.hash[c];
+            for (int ch = 0; ch < active; ++ch) {
+                __m256 term = _mm256_mul_ps(falloff4, gradientDotAVX2(table, h, cell.dx[c], cell.dy[c], cell.dz[c], nullptr));
+                terms[ch] = c == 0 ? term : _mm256_add_ps(terms[ch], term);
+                h = _mm256_add_epi32(h, _mm256_set1_epi32(NoiseTable::CHANNEL_OFFSET));
+            }
+        }
+        const __m256 v_amp = _mm256_set1_ps(octaves.amp[O]);
+        for (int ch = 0; ch < active; ++ch) {
+            sums[ch] = _mm256_add_ps(sums[ch], _mm256_mul_ps(v_amp, _mm256_mul_ps(_mm256_set1_ps(SCALE_3D), terms[ch])));
+        }
+        addOctavesAVX2<O + 1, OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, px, py, pz, sums);
+    }
+}
+
+// Whole batches of eight points of SimplexKernel::unrolledChannels(), returning how many points
+// that covers
+template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+SIMPLEX_TARGET_AVX2
+static int unrolledChannelsAVX2(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                const float *z, int count, float *const *out) {
+    int n = 0;
+    for (; n + 8 <= count; n += 8) {
+        __m256 sums[CHANNELS];
+        for (auto &sum: sums) sum = _mm256_setzero_ps();
+        addOctavesAVX2<0, OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, _mm256_loadu_ps(x + n),
+                                                              _mm256_loadu_ps(y + n), _mm256_loadu_ps(z + n), sums);
+        for (int ch = 0; ch < CHANNELS; ++ch) _mm256_storeu_ps(out[ch] + n, sums[ch]);
+    }
+    return n;
+}
+
+#endif
+
+template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+void SimplexKernel::unrolledChannels(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                     const float *z, int count, float *const *out) {
+    int n = 0;
+#ifdef SIMPLEX_X86
+    if (PerlinKernel::hasAVX2()) n = unrolledChannelsAVX2<OCTAVES, CHANNELS, CHANNEL_OCTAVES>(table, octaves, x, y, z, count, out);
+#endif
+    for (; n < count; ++n) {
+        float h[CHANNELS] = {};
+        [&]<int... O>(std::integer_sequence<int, O...>) {
+            ([&] {
+                constexpr int active = O < CHANNEL_OCTAVES ? CHANNELS : 1;
+                float f = octaves.freq[O], v[NoiseTable::MAX_CHANNELS];
+                simplexChannels(table, x[n] * f, y[n] * f, z[n] * f, active, v);
+                for (int c = 0; c < active; ++c) h[c] += octaves.amp[O] * v[c];
+            }(), ...);
+        }(std::make_integer_sequence<int, OCTAVES>());
+        for (int c = 0; c < CHANNELS; ++c) out[c][n] = h[c];
+    }
+}
+
+template <int CHANNELS, int CHANNEL_OCTAVES>
+NoisePointsKernel SimplexKernel::unrolledPoints(int octaves) {
+    return [&]<int... O>(std::integer_sequence<int, O...>) {
+        static const NoisePointsKernel kernels[] = { &unrolledChannels<O, CHANNELS, CHANNEL_OCTAVES>... };
+        return kernels[octaves];
+    }(std::make_integer_sequence<int, Octaves::MAX_COUNT + 1>());
+}
+
+// Moons: heights alone. Rocky planets: heights, temperature and moisture, the latter two over
+// TerrainGenerator::BIOME_OCTAVES octaves.
+template NoisePointsKernel SimplexKernel::unrolledPoints<1, 0>(int octaves);
+template NoisePointsKernel SimplexKernel::unrolledPoints<3, 3>(int octaves);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "utils/perlinkernel.h"
+
+// Simplex noise over the same gradient tables and octaves as PerlinKernel. A 2D sample blends the
+// three corners of its triangle and a 3D sample the four corners of its tetrahedron, against four
+// and eight cube corners for Perlin noise, and since the simplex lattice has no axis-aligned cell
+// edges its features show fewer horizontal and vertical streaks. Results are scaled to the spread
+// of Perlin noise, so that palettes and thresholds tuned for one suit the other.
+class SimplexKernel {
+public:
+    // Same contract as PerlinKernel::heightRow(). A row that wraps (Octaves::wrap > 0) is sampled
+    // in 3D on a cylinder around the row axis whose circumference is the period, so it repeats
+    // without having to fold the skewed simplex lattice onto itself.
+    static void heightRow(const NoiseTable &table, const Octaves &octaves, float x, int col0, float dz,
+                          int count, float *out);
+
+    // The y and z coordinates on that cylinder of columns [col0, col0 + count) of a wrapped row,
+    // e.g. for the GPU baker to sample the same points
+    static void wrapColumns(const Octaves &octaves, int col0, float dz, int count, float *y, float *z);
+
+    // out[i] = height(x[i], y[i], z[i]) for i in [0, count), e.g. the directions of a cube map row,
+    // eight points at a time where AVX2 is available. Matches height() exactly on every path.
+    static void heightPoints(const NoiseTable &table, const Octaves &octaves,
+                             const float *x, const float *y, const float *z, int count, float *out);
+
+    // The same, also writing the partial derivatives of each height along x, y and z
+    static void heightPoints(const NoiseTable &table, const Octaves &octaves,
+                             const float *x, const float *y, const float *z, int count, float *out,
+                             float *gradX, float *gradY, float *gradZ);
+
+    // See PerlinKernel::channelPoints(); every channel also shares the corners' falloff
+    static void channelPoints(const NoiseTable &table, const Octaves &octaves, int channels, int channelOctaves,
+                              const float *x, const float *y, const float *z, int count, float *const *out);
+
+    // Scalar reference implementation of channelPoints()
+    static void channelPointsScalar(const NoiseTable &table, const Octaves &octaves, int channels, int channelOctaves,
+                                    const float *x, const float *y, const float *z, int count, float *const *out);
+
+    // See PerlinKernel::unrolledPoints(). With AVX2, each batch of eight points runs through all
+    // octaves with its sums in registers, rather than every octave through all points.
+    template <int CHANNELS, int CHANNEL_OCTAVES>
+    static NoisePointsKernel unrolledPoints(int octaves);
+
+    // Single 2D and 3D simplex samples, and the 3D fractal sum over the given octaves
+    static float simplex(const NoiseTable &table, float x, float y);
+    static float simplex(const NoiseTable &table, float x, float y, float z);
+    static float height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z);
+
+    // 3D samples that also write their analytic partial derivatives to grad, see PerlinKernel
+    static float simplex(const NoiseTable &table, float x, float y, float z, float grad[3]);
+    static float height(const NoiseTable &table, const Octaves &octaves, float x, float y, float z, float grad[3]);
+
+private:
+    // 3D noise of the first `channels` channels at one point, out[0] being simplex()
+    static void simplexChannels(const NoiseTable &table, float x, float y, float z, int channels, float *out);
+
+    template <int OCTAVES, int CHANNELS, int CHANNEL_OCTAVES>
+    static void unrolledChannels(const NoiseTable &table, const Octaves &octaves, const float *x, const float *y,
+                                 const float *z, int count, float *const *out);
+
+    // Add one octave to out, and to the derivatives unless gradX is null
+    static void octavePointsScalar(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                   int count, float freq, float amp, float *out,
+                                   float *gradX, float *gradY, float *gradZ);
+    static void octavePointsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                 int count, float freq, float amp, float *out,
+                                 float *gradX, float *gradY, float *gradZ);
+    static void octaveChannelsAVX2(const NoiseTable &table, const float *x, const float *y, const float *z,
+                                   int count, float freq, float amp, int channels, float *const *out);
+};
@@ -1,150 +1,87 @@
 // Part of the codes are from lab 7
 
 #include "terraingenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <random>
+#include "glm/gtc/constants.hpp"
+#include "utils/terrainpipeline.h"
+#include "utils/texturemap.h"
+
+NoiseTable TerrainGenerator::createNoise(unsigned int seed) const {
+    NoiseTable noise;
+    noise.randomize(seed);
+    return noise;
+}
 
-void TerrainGenerator::updateNoise() {
-    std::random_device rd;
-    std::mt19937 mt(rd());
-    std::uniform_real_distribution<float> dist(-1.f, 1.f);
-
-    m_randVecLookup.clear();
-    for (int i = 0; i < m_lookupSize; i++)
-    {
-        m_randVecLookup.push_back(glm::vec2(dist(mt), dist(mt)));
-    }
+std::vector<glm::vec3> TerrainGenerator::getPalette(int index) {
+    std::vector<glm::vec3> palette;
+    for (auto &color: PALETTES[index]) palette.emplace_back(color[0], color[1], color[2]);
+    return palette;
 }
 
 TerrainGenerator::TerrainGenerator() {
-    // Define resolution of terrain generation
+    // Define default resolution of terrain generation
     m_resolution = 512;
 
-    // Generate random vector lookup table
-    m_lookupSize = 1024;
-    m_randVecLookup.reserve(m_lookupSize);
-
-    // prepare color palette
-    // https://imgur.com/a/OCCq2gl
-    // Sun
-    planet_color_palette[0] = std::vector{glm::vec3(0.97, 0.43, 0.10),
-                                          glm::vec3(0.95, 0.36, 0.14),
-                                          glm::vec3(0.99, 0.73, 0.00),
-                                          glm::vec3(1.00, 0.91, 0.55)};
-    // Mercury
-    planet_color_palette[1] = std::vector{glm::vec3(0.35, 0.35, 0.34),
-                                          glm::vec3(0.75, 0.74, 0.74),
-                                          glm::vec3(0.55, 0.54, 0.53),
-                                          glm::vec3(0.96, 0.96, 0.97)};
-    // Venus
-    planet_color_palette[2] = std::vector{glm::vec3(0.75, 0.77, 0.78),
-                                          glm::vec3(0.85, 0.69, 0.57),
-                                          glm::vec3(0.96, 0.86, 0.77),
-                                          glm::vec3(0.97, 0.99, 0.99)};
-    // Earth
-    planet_color_palette[3] = std::vector{glm::vec3(0.12, 0.22, 0.44),
-                                          glm::vec3(0.85, 0.75, 0.64),
-                                          glm::vec3(0.22, 0.44, 0.38),
-                                          glm::vec3(0.95, 0.98, 0.97)};
-    // Mars
-    planet_color_palette[4] = std::vector{glm::vec3(0.55, 0.36, 0.29),
-                                          glm::vec3(0.95, 0.48, 0.37),
-                                          glm::vec3(0.76, 0.43, 0.36),
-                                          glm::vec3(0.85, 0.74, 0.62)};
-    // Jupiter
-    planet_color_palette[5] = std::vector{glm::vec3(0.60, 0.45, 0.07),
-                                          glm::vec3(0.75, 0.51, 0.22),
-                                          glm::vec3(0.75, 0.69, 0.61),
-                                          glm::vec3(0.65, 0.44, 0.36)};
-    // Saturn
-    planet_color_palette[6] = std::vector{glm::vec3(0.95, 0.81, 0.53),
-                                          glm::vec3(0.85, 0.72, 0.47),
-                                          glm::vec3(0.62, 0.58, 0.44),
-                                          glm::vec3(0.75, 0.64, 0.50)};
-    // Uranus
-    planet_color_palette[7] = std::vector{glm::vec3(0.64, 0.80, 0.82),
-                                          glm::vec3(0.66, 0.82, 0.84),
-                                          glm::vec3(0.71, 0.86, 0.87),
-                                          glm::vec3(0.82, 0.94, 0.94)};
-    // Neptune
-    planet_color_palette[8] = std::vector{glm::vec3(0.37, 0.38, 0.60),
-                                          glm::vec3(0.40, 0.48, 0.65),
-                                          glm::vec3(0.45, 0.58, 0.75),
-                                          glm::vec3(0.47, 0.62, 0.75)};
-    // Moon
-    planet_color_palette[9] = std::vector{glm::vec3(0.84, 0.70, 0.73),
-                                          glm::vec3(0.66, 0.62, 0.59),
-                                          glm::vec3(0.96, 0.92, 0.87),
-                                          glm::vec3(0.25, 0.17, 0.09)};
+    for (int index = 0; index < PALETTE_COUNT; ++index) {
+        m_palette_ramps[index] = std::make_shared<const PaletteRamp>(PaletteRamp::compile(getPalette(index)));
+    }
+
+    // Solid surfaces show the axis-aligned streaks of Perlin noise the most, and are the costliest
+    // to generate as cube maps, so they use simplex noise
+    m_noise_bases[PLANET_SUN] = PlanetTraits<PLANET_SUN>::BASIS;
+    m_noise_bases[PLANET_MOON] = PlanetTraits<PLANET_MOON>::BASIS;
+    m_noise_bases[PLANET_ROCKY] = PlanetTraits<PLANET_ROCKY>::BASIS;
+    m_noise_bases[PLANET_GAS] = NoiseBasis::PERLIN;
 }
 
 TerrainGenerator::~TerrainGenerator() {
-    m_randVecLookup.clear();
 }
 
-void insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+void TerrainGenerator::generateTerrainNormals(const TerrainJob &job, std::uint8_t *out, std::size_t stride) const {
+    generateNormalRows(job, 0, job.resolution, out, stride);
 }
 
-std::vector<float>& TerrainGenerator::generateTerrainNormals() {
-    for (int x = 0; x < m_resolution; ++x) {
-        for(int y = 0; y < m_resolution * 2; ++y) {
-            if (y <= m_resolution - 1) {
-                auto n = getNormal(x, y);
-                insertVec3(normals, n * 0.5f + 0.5f);
-            }
-            else {
-                auto n = getNormal(x, ((m_resolution - 1) - y % (m_resolution)));
-                insertVec3(normals, n * 0.5f + 0.5f);
-            }
-            normals.push_back(1.0);
-        }
-    }
+std::vector<std::uint8_t> TerrainGenerator::generateTerrainNormals(const TerrainJob &job) const {
+    std::vector<std::uint8_t> normals(job.resolution * job.resolution * 2 * 2);
+    generateTerrainNormals(job, normals.data());
     return normals;
 }
 
-std::vector<float>& TerrainGenerator::generateTerrainColors(int type) {
-    colors.clear();
-    updateNoise();
-    for (int x = 0; x < m_resolution; ++x) {
-        for(int y = 0; y < m_resolution * 2; ++y) {
-            glm::vec3 color;
-            if (type < 5) {
-                glm::vec3 pos;
-                if (y <= m_resolution - 1) {
-                    pos = getPosition(x, y);
-                }
-                else {
-                    pos = getPosition(x, ((m_resolution - 1) - y % (m_resolution)));
-                }
-                color = getColorFromPerlin(pos, planet_color_palette[type]);
-            }
-            else {
-                color = getColorForRing(x, y, planet_color_palette[type]);
-            }
-            insertVec3(colors, color);
-            colors.push_back(1.0);
-        }
-    }
-    return colors;
+TerrainJob TerrainGenerator::createJob(int type, unsigned int seed, int resolution) const {
+    if (resolution == 0) resolution = m_resolution;
+    TerrainJob job;
+    job.name = "palette" + std::to_string(type);
+    job.seed = seed;
+    job.resolution = resolution;
+    job.noise = createNoise(seed);
+    job.palette = getPalette(type);
+    job.banded = type >= 5;
+    job.ramp = m_palette_ramps.at(type);
+    return job;
 }
 
-std::vector<float>& TerrainGenerator::generateTerrainColors(PlanetType type) {
+TerrainJob TerrainGenerator::createJob(PlanetType type, unsigned int seed, int resolution) const {
     std::vector<glm::vec3> palette;
+    std::string name;
+    std::mt19937 mt(seed);
 
     if (type == PlanetType::PLANET_SUN) {
-        palette = planet_color_palette[0];
+        palette = getPalette(0);
+        name = "sun";
     } else if (type == PlanetType::PLANET_MOON) {
-        palette = planet_color_palette[9];
+        palette = getPalette(9);
+        name = "moon";
     } else if (type == PlanetType::PLANET_ROCKY) {
-        palette = planet_color_palette[1 + rand() % 4];
+        palette = getPalette(1 + mt() % 4);
+        name = "rocky";
     } else {
-        palette = planet_color_palette[5 + rand() % 4];
+        palette = getPalette(5 + mt() % 4);
+        name = "gas";
     }
 
-    std::random_device rd;
-    std::mt19937 mt(rd());
     std::uniform_real_distribution<float> dist(-0.05f, 0.05f);
 
     for (int i = 0; i < palette.size(); ++i) {
@@ -153,191 +90,415 @@ std::vector<float>& TerrainGenerator::generateTerrainColors(PlanetType type) {
         palette[i].z += dist(mt);
     }
 
-    updateNoise();
-    colors.clear();
-    for (int x = 0; x < m_resolution; ++x) {
-        for(int y = 0; y < m_resolution * 2; ++y) {
-            glm::vec3 color;
-            if (type != PlanetType::PLANET_GAS) {
-                glm::vec3 pos;
-                if (y <= m_resolution - 1) {
-                    pos = getPosition(x, y);
-                }
-                else {
-                    pos = getPosition(x, ((m_resolution - 1) - y % (m_resolution)));
-                }
-
-                color = getColorFromPerlin(pos, palette);
-            }
-            else {
-                color = getColorForRing(x, y, palette);
-            }
-            insertVec3(colors, color);
-            colors.push_back(1.0);
-        }
+    // The jittered palette is compiled once here, every texel of the job then samples it
+    if (resolution == 0) resolution = m_resolution;
+    TerrainJob job;
+    job.name = name;
+    job.seed = seed;
+    job.resolution = resolution;
+    job.noise = createNoise(mt());
+    job.basis = getNoiseBasis(type);
+    job.palette = palette;
+    job.banded = type == PlanetType::PLANET_GAS;
+    job.ramp = std::make_shared<const PaletteRamp>(PaletteRamp::compile(palette));
+    if (type == PlanetType::PLANET_ROCKY) job.biomes = std::make_shared<const BiomeTable>(BiomeTable::compile(palette));
+    if (type == PlanetType::PLANET_MOON) {
+        job.craterDepth = MOON_CRATER_DEPTH;
+        job.craterDensity = MOON_CRATER_DENSITY;
+    } else if (type == PlanetType::PLANET_ROCKY) {
+        job.craterDepth = ROCKY_CRATER_DEPTH;
+        job.craterDensity = ROCKY_CRATER_DENSITY;
     }
-    return colors;
+    if (job.basis != NoiseBasis::PERLIN) job.name += std::string("_") + NoiseKernel::name(job.basis);
+    return job;
 }
 
-std::vector<float> &TerrainGenerator::generateTerrainDisplacement() {
-    return displacement;
+TerrainJob TerrainGenerator::createCloudJob(unsigned int seed, int resolution) const {
+    if (resolution == 0) resolution = m_resolution;
+    TerrainJob job;
+    job.name = "clouds";
+    job.seed = seed;
+    job.resolution = resolution;
+    job.noise = createNoise(seed);
+    job.basis = NoiseBasis::SIMPLEX;
+    return job;
 }
 
-glm::vec2 TerrainGenerator::sampleRandomVector(int row, int col) {
-    std::hash<int> intHash;
-    int index = intHash(row * 41 + col * 43) % m_lookupSize;
-    return m_randVecLookup.at(index);
+std::vector<std::uint8_t> TerrainGenerator::generateTerrainColors(int type, unsigned int seed) const {
+    return generateTerrainColors(createJob(type, seed));
 }
 
-glm::vec3 TerrainGenerator::getPosition(int row, int col) {
-    // Normalizing the planar coordinates to a unit square
-    // makes scaling independent of sampling resolution.
-    // Use Y-up coordinate
-    float x = 1.0 * row / m_resolution;
-    float z = 1.0 * col / m_resolution;
-    float y = getHeight(x, z);
-    return glm::vec3(x,y,z);
+std::vector<std::uint8_t> TerrainGenerator::generateTerrainColors(PlanetType type, unsigned int seed) const {
+    return generateTerrainColors(createJob(type, seed));
 }
 
-float TerrainGenerator::getHeight(float x, float y) {
-    // Task 6: modify this call to produce noise of a different frequency
-    float z = 1.f/2 * computePerlin(x * 2, y * 2);
+void TerrainGenerator::generateTerrainColors(const TerrainJob &job, std::uint8_t *out, std::size_t stride) const {
+    generateColorRows(job, 0, job.height(), out, stride);
+}
 
-    // Task 7: combine multiple different octaves of noise to produce fractal perlin noise
-    z += 1.f/4 * computePerlin(x * 4, y * 4);
-    z += 1.f/8 * computePerlin(x * 8, y * 8);
-    z += 1.f/16 * computePerlin(x * 16, y * 16);
+std::vector<std::uint8_t> TerrainGenerator::generateTerrainColors(const TerrainJob &job) const {
+    std::vector<std::uint8_t> colors(job.width() * job.height() * 4);
+    generateTerrainColors(job, colors.data());
+    return colors;
+}
 
-    // Return 0 as placeholder
-    return z;
+int TerrainGenerator::selectResolution(float screenDiameter) const {
+    // Half the map's width wraps around the visible hemisphere, whose center shows the most
+    // surface per pixel: pi / 2 texels of height per pixel of diameter keep it unmagnified
+    float needed = glm::pi<float>() / 2 * screenDiameter;
+
+    int resolution = MIN_RESOLUTION;
+    while (resolution < needed && resolution < m_resolution) resolution *= 2;
+    return std::min(resolution, m_resolution);
+}
+
+BandSynthesizer TerrainGenerator::createBands(const TerrainJob &job) const {
+    return BandSynthesizer(job.bands, job.palette, job.resolution, job.turbulence, job.noise);
 }
 
-glm::vec3 TerrainGenerator::getNormal(int row, int col) {
-    // Task 9: Compute the average normal for the given input indices
-    // TODO: How to get neighbors' indices?
-
-    // Reference: https://cs1230.graphics/labs/lab7-get-normals/
-    // TA SOLUTION
-    glm::vec3 normal = glm::vec3(0, 0, 0);
-    std::vector<std::vector<int>> neighborOffsets = { // Counter-clockwise around the vertex
-            {-1, -1},
-            { 0, -1},
-            { 1, -1},
-            { 1,  0},
-            { 1,  1},
-            { 0,  1},
-            {-1,  1},
-            {-1,  0}
-    };
-    glm::vec3 V = getPosition(row,col);
-    for (int i = 0; i < 8; ++i) {
-        int n1RowOffset = neighborOffsets[i][0];
-        int n1ColOffset = neighborOffsets[i][1];
-        int n2RowOffset = neighborOffsets[(i + 1) % 8][0];
-        int n2ColOffset = neighborOffsets[(i + 1) % 8][1];
-        glm::vec3 n1 = getPosition(row + n1RowOffset, col + n1ColOffset);
-        glm::vec3 n2 = getPosition(row + n2RowOffset, col + n2ColOffset);
-        normal = normal + glm::cross(n1 - V, n2 - V);
+glm::vec3 TerrainGenerator::getCubeDirection(int face, float sc, float tc) {
+    switch (face) {
+        case 0: return glm::vec3(1, -tc, -sc);
+        case 1: return glm::vec3(-1, -tc, sc);
+        case 2: return glm::vec3(sc, 1, tc);
+        case 3: return glm::vec3(sc, -1, -tc);
+        case 4: return glm::vec3(sc, -tc, 1);
+        default: return glm::vec3(-sc, -tc, -1);
     }
-    return glm::normalize(normal);
 }
 
-glm::vec3 TerrainGenerator::getColorFromPerlin(glm::vec3 position, std::vector<glm::vec3> &palette) {
-    glm::vec3 result;
-    auto height = position.y;
-    float threshold[7] = {0.05, 0.04, 0.02, 0.01, -0.01, -0.015, -0.03};
+// Direction from the cube's center through the center of texel (row, col) of a size x size face
+static glm::vec3 getTexelDirection(int face, int row, int col, int size) {
+    return TerrainGenerator::getCubeDirection(face, 2.f * (col + 0.5f) / size - 1.f, 2.f * (row + 0.5f) / size - 1.f);
+}
+
+std::vector<TerrainTile> TerrainGenerator::createTiles(const TerrainJob &job) const {
+    // Cube faces are powers of two, so a tile size that fits a face also divides it
+    int size = job.cubemap ? std::min(TILE_SIZE, job.width()) : TILE_SIZE;
+    std::vector<TerrainTile> tiles;
+    for (int row = 0; row < job.height(); row += size) {
+        for (int col = 0; col < job.width(); col += size) {
+            tiles.push_back({row, col, std::min(size, job.width() - col), std::min(size, job.height() - row)});
+        }
+    }
+    return tiles;
+}
+
+void TerrainGenerator::generateColorTile(const TerrainJob &job, const BandSynthesizer *bands, const TerrainTile &tile,
+                                         std::uint8_t *out, std::size_t stride) const {
+    if (stride == 0) stride = tile.width * 4;
+
+    if (job.cubemap && job.banded) {
+        // Bands follow latitude, so sample the 2:1 map with the sphere's uv mapping, bilinearly
+        // and wrapping around in longitude, so that the color varies continuously with the
+        // direction and the baker's slightly different directions land on nearly the same color
+        int size = job.width();
+        int rows = job.resolution, cols = job.resolution * 2;
+        for (int r = tile.row; r < tile.row + tile.height; ++r) {
+            std::uint8_t *row = out + (r - tile.row) * stride;
+            for (int col = tile.col; col < tile.col + tile.width; ++col) {
+                auto dir = glm::normalize(getTexelDirection(r / size, r % size, col, size));
+                auto uv = TextureMap::getUVAt(dir * 0.5f, PrimitiveType::PRIMITIVE_SPHERE);
+                float fx = glm::clamp(uv.y * rows - 0.5f, 0.f, rows - 1.f);
+                float fy = uv.x * cols - 0.5f;
+                int x0 = std::min(int(fx), rows - 2);
+                int y0 = int(std::floor(fy));
+                float tx = fx - x0, ty = fy - y0;
+                y0 = (y0 + cols) % cols;
+                int y1 = (y0 + 1) % cols;
+                const std::uint8_t *c00 = bands->texel(x0, y0), *c01 = bands->texel(x0, y1);
+                const std::uint8_t *c10 = bands->texel(x0 + 1, y0), *c11 = bands->texel(x0 + 1, y1);
+                for (int c = 0; c < 4; ++c) {
+                    float top = c00[c] + (c01[c] - c00[c]) * ty;
+                    float bottom = c10[c] + (c11[c] - c10[c]) * ty;
+                    row[(col - tile.col) * 4 + c] = (std::uint8_t)(top + (bottom - top) * tx + 0.5f);
+                }
+            }
+        }
+        return;
+    }
 
-    if (height >= threshold[0]) {
-        result = palette[3];
+    if (job.banded) {
+        bands->fill(tile.row, tile.col, tile.width, tile.height, out, stride);
+        return;
     }
-    else if (height >= threshold[1]) {
-        auto a = (height-threshold[1])/(threshold[0]-threshold[1]);
-        result = glm::mix(palette[2], palette[3], a);
+
+    if (job.cubemap || job.sampledOnSphere()) {
+        generateSphereTile(job, tile, out, stride);
+        return;
     }
-    else if (height >= threshold[2]) {
-        result = palette[2];
+
+    // One batched noise row per texel row, which wraps around at the map's right edge
+    auto octaves = job.octaves();
+    std::vector<float> heights(tile.width);
+    for (int x = tile.row; x < tile.row + tile.height; ++x) {
+        NoiseKernel::heightRow(job.basis, job.noise, octaves, 1.f * x / job.resolution, tile.col, 1.f / job.resolution,
+                               tile.width, heights.data());
+        job.ramp->sampleRow(heights.data(), tile.width, out + (x - tile.row) * stride);
     }
-    else if (height >= threshold[3]) {
-        auto a = (height-threshold[3])/(threshold[2]-threshold[3]);
-        result = glm::mix(palette[1], palette[2], a);
+}
+
+void TerrainGenerator::generateSphereTile(const TerrainJob &job, const TerrainTile &tile, std::uint8_t *out,
+                                          std::size_t stride) const {
+    auto octaves = job.octaves();
+    auto craters = job.craters();
+    auto kernel = TerrainPipeline::select(job, octaves);
+    int size = job.width();
+    std::vector<float> x(tile.width), y(tile.width), z(tile.width);
+    for (int r = tile.row; r < tile.row + tile.height; ++r) {
+        // Texel directions as for the normal map, see generateNormalRows(), on the noise sphere of
+        // getHeightsForDirections()
+        float latitude = ((r + 0.5f) / job.resolution - 0.5f) * glm::pi<float>();
+        for (int col = tile.col; col < tile.col + tile.width; ++col) {
+            glm::vec3 dir;
+            if (job.cubemap) {
+                dir = glm::normalize(getTexelDirection(r / size, r % size, col, size));
+            } else {
+                float theta = -2 * glm::pi<float>() * (col + 0.5f) / size;
+                dir = glm::vec3(std::cos(latitude) * std::cos(theta), std::sin(latitude),
+                                std::cos(latitude) * std::sin(theta));
+            }
+            auto p = dir / glm::pi<float>();
+            x[col - tile.col] = p.x;
+            y[col - tile.col] = p.y;
+            z[col - tile.col] = p.z;
+        }
+        shadeSphereRow(job, octaves, craters, kernel, x.data(), y.data(), z.data(), tile.width,
+                       out + (r - tile.row) * stride);
     }
-    else if (height >= threshold[4]) {
-        result = palette[1];
+}
+
+void TerrainGenerator::shadeSphereRow(const TerrainJob &job, const Octaves &octaves, const Craters &craters,
+                                      NoisePointsKernel kernel, const float *x, const float *y, const float *z,
+                                      int count, std::uint8_t *out) const {
+    std::vector<float> heights(count);
+    if (job.biomes == nullptr) {
+        if (kernel != nullptr) {
+            float *channels[1] = { heights.data() };
+            kernel(job.noise, octaves, x, y, z, count, channels);
+        } else {
+            NoiseKernel::heightPoints(job.basis, job.noise, octaves, x, y, z, count, heights.data());
+        }
+        CraterKernel::addPoints(job.noise, craters, x, y, z, count, heights.data());
+        job.ramp->sampleRow(heights.data(), count, out);
+        return;
     }
-    else if (height >= threshold[5]) {
-        auto a = (height-threshold[5])/(threshold[4]-threshold[5]);
-        result = glm::mix(palette[0], palette[1], a);
+
+    std::vector<float> temperatures(count), moistures(count);
+    float *channels[3] = { heights.data(), temperatures.data(), moistures.data() };
+    if (kernel != nullptr) {
+        kernel(job.noise, octaves, x, y, z, count, channels);
+    } else {
+        NoiseKernel::channelPoints(job.basis, job.noise, octaves, 3, BIOME_OCTAVES, x, y, z, count, channels);
     }
-    else {
-        result = palette[0];
+    CraterKernel::addPoints(job.noise, craters, x, y, z, count, heights.data());
+
+    // y is sin(latitude) / pi
+    for (int i = 0; i < count; ++i) {
+        temperatures[i] = BiomeTable::temperature(temperatures[i], y[i] * glm::pi<float>(), heights[i]);
+        moistures[i] = BiomeTable::moisture(moistures[i]);
     }
+    job.biomes->shadeRow(*job.ramp, heights.data(), temperatures.data(), moistures.data(), count, out);
+}
 
-    // Return white as placeholder
-    return result;
+void TerrainGenerator::generateCubePage(const TerrainJob &job, int faceSize, int face, int row, int col, int size,
+                                        std::uint8_t *out, std::size_t stride) const {
+    if (stride == 0) stride = size * 4;
+
+    // The job at the resolution whose cube faces are faceSize wide, for its octaves and craters
+    auto page_job = job;
+    page_job.resolution = faceSize * 2;
+    auto octaves = page_job.octaves();
+    auto craters = page_job.craters();
+    auto kernel = TerrainPipeline::select(page_job, octaves);
+    std::vector<float> x(size), y(size), z(size);
+    for (int r = 0; r < size; ++r) {
+        for (int c = 0; c < size; ++c) {
+            auto p = glm::normalize(getTexelDirection(face, row + r, col + c, faceSize)) / glm::pi<float>();
+            x[c] = p.x;
+            y[c] = p.y;
+            z[c] = p.z;
+        }
+        shadeSphereRow(page_job, octaves, craters, kernel, x.data(), y.data(), z.data(), size, out + r * stride);
+    }
 }
 
-// Helper for computePerlin() and, possibly, getColorFromPerlin()
-float interpolate(float A, float B, float alpha) {
-    // Task 4: implement your easing/interpolation function below
-    auto ease = 3 * pow(alpha,2) - 2 * pow(alpha, 3);
+void TerrainGenerator::generateColorRows(const TerrainJob &job, int rowBegin, int rowEnd,
+                                         std::uint8_t *out, std::size_t stride) const {
+    if (stride == 0) stride = job.width() * 4;
 
-    // Return 0 as placeholder
-    return A + ease * (B - A);
-}
+    // The band tables cost about a row's worth of work, so they are built once per call
+    std::unique_ptr<BandSynthesizer> bands;
+    if (job.banded) bands = std::make_unique<BandSynthesizer>(createBands(job));
 
-float TerrainGenerator::computePerlin(float x, float y) {
-    // Task 1: get grid indices (as ints)
-    int base_x = floor(x);
-    int base_y = floor(y);
-
-    // Task 2: compute offset vectors
-    auto intersect = glm::vec2(x, y);
-    auto offset_tl = intersect - glm::vec2(base_x, base_y);
-    auto offset_tr = intersect - glm::vec2(base_x + 1, base_y);
-    auto offset_bl = intersect - glm::vec2(base_x, base_y + 1);
-    auto offset_br = intersect - glm::vec2(base_x + 1, base_y + 1);
-
-    // Task 3: compute the dot product between offset and grid vectors
-    auto dot_tl = glm::dot(sampleRandomVector(base_x, base_y), offset_tl);
-    auto dot_tr = glm::dot(sampleRandomVector(base_x + 1, base_y), offset_tr);
-    auto dot_bl = glm::dot(sampleRandomVector(base_x, base_y + 1), offset_bl);
-    auto dot_br = glm::dot(sampleRandomVector(base_x + 1, base_y + 1), offset_br);
-
-    // Task 5: use your interpolation function to produce the final value
-    auto G = interpolate(dot_tl, dot_tr, x-base_x);
-    auto H = interpolate(dot_bl, dot_br, x-base_x);
-
-    // Return 0 as a placeholder
-    return interpolate(G, H, y-base_y);
+    TerrainTile tile {rowBegin, 0, job.width(), rowEnd - rowBegin};
+    generateColorTile(job, bands.get(), tile, out + rowBegin * stride, stride);
 }
 
-glm::vec3 TerrainGenerator::getColorForRing(int x, int y, std::vector<glm::vec3> &palette) {
-    auto t = getBezierCurve(0, 75 + x % 25, 0, float(y/2)/m_resolution);
-    x += t;
-    if (x < m_resolution / 8) {
-        return palette[3];
+void TerrainGenerator::generateNormalRows(const TerrainJob &job, int rowBegin, int rowEnd,
+                                          std::uint8_t *out, std::size_t stride) const {
+    int width = job.resolution * 2;
+    if (stride == 0) stride = width * 2;
+
+    // Banded maps have no relief, so their normals all point straight out
+    if (job.banded) {
+        for (int x = rowBegin; x < rowEnd; ++x) std::fill(out + x * stride, out + x * stride + width * 2, 128);
+        return;
     }
-    else if (x < 2 * m_resolution / 8) {
-        return palette[2];
+
+    // Texel centers at latitude (v - 0.5) * pi and longitude -2 * pi * u, which inverts
+    // TextureMap::getUVAt() for spheres. u runs east along (sin(theta), 0, -cos(theta)) and v
+    // north along (-sin(lat) cos(theta), cos(lat), -sin(lat) sin(theta)).
+    auto octaves = job.octaves();
+    std::vector<glm::vec2> longitudes(width);
+    for (int col = 0; col < width; ++col) {
+        float theta = -2 * glm::pi<float>() * (col + 0.5f) / width;
+        longitudes[col] = glm::vec2(std::cos(theta), std::sin(theta));
     }
-    else if (x < 7 * m_resolution / 16) {
-        return palette[1];
+    std::vector<glm::vec3> dirs(width), gradients(width);
+    std::vector<float> heights(width);
+    for (int x = rowBegin; x < rowEnd; ++x) {
+        float latitude = ((x + 0.5f) / job.resolution - 0.5f) * glm::pi<float>();
+        float y = std::sin(latitude), r = std::cos(latitude);
+        for (int col = 0; col < width; ++col) {
+            auto &l = longitudes[col];
+            dirs[col] = glm::vec3(r * l.x, y, r * l.y);
+        }
+        getHeightsForDirections(job, octaves, dirs, heights.data(), gradients.data());
+
+        // The noise sphere has radius 1 / pi, so the slopes along u and v per noise unit are the
+        // gradient's tangential components times pi
+        std::uint8_t *row = out + x * stride;
+        for (int col = 0; col < width; ++col) {
+            auto &l = longitudes[col];
+            auto g = gradients[col] * glm::pi<float>();
+            float su = g.x * l.y - g.z * l.x;
+            float sv = -y * (g.x * l.x + g.z * l.y) + r * g.y;
+            auto n = glm::normalize(glm::vec3(-NORMAL_RELIEF * su, -NORMAL_RELIEF * sv, 1));
+            row[col * 2] = (std::uint8_t)(n.x * 127.5f + 128.f);
+            row[col * 2 + 1] = (std::uint8_t)(n.y * 127.5f + 128.f);
+        }
     }
-    else if (x < 5 * m_resolution / 8) {
-        return palette[0];
+}
+
+void TerrainGenerator::generateCloudRows(const TerrainJob &job, float time, int rowBegin, int rowEnd,
+                                         std::uint8_t *out, std::size_t stride) const {
+    int width = job.resolution * 2;
+    if (stride == 0) stride = width;
+
+    // Texels are CLOUD_SCALE / resolution noise units apart on a sphere of radius CLOUD_SCALE / pi
+    auto octaves = Octaves::forSpacing(CLOUD_SCALE / job.resolution);
+    octaves.count = std::min(octaves.count, CLOUD_OCTAVES);
+    float radius = CLOUD_SCALE / glm::pi<float>();
+    std::vector<float> x(width), y(width), z(width), coverage(width);
+    for (int r = rowBegin; r < rowEnd; ++r) {
+        // Texel directions as for the normal map, see generateNormalRows()
+        float latitude = ((r + 0.5f) / job.resolution - 0.5f) * glm::pi<float>();
+        for (int col = 0; col < width; ++col) {
+            float theta = -2 * glm::pi<float>() * (col + 0.5f) / width;
+            x[col] = radius * std::cos(latitude) * std::cos(theta);
+            y[col] = radius * std::sin(latitude) + time;
+            z[col] = radius * std::cos(latitude) * std::sin(theta);
+        }
+        NoiseKernel::heightPoints(job.basis, job.noise, octaves, x.data(), y.data(), z.data(), width, coverage.data());
+
+        std::uint8_t *row = out + r * stride;
+        for (int col = 0; col < width; ++col) {
+            float c = std::min(std::max((coverage[col] - CLOUD_THRESHOLD) / CLOUD_SOFTNESS, 0.f), 1.f);
+            row[col] = (std::uint8_t)(c * 255.f + 0.5f);
+        }
     }
-    else if (x < 6 * m_resolution / 8) {
-        return palette[1];
+}
+
+std::vector<float> TerrainGenerator::generateTerrainDisplacement(const TerrainJob &job, int face, float sc, float tc,
+                                                                float size, int quads) const {
+    // The job at the resolution whose texels are as far apart as the vertices, near the face's
+    // center where a face unit spans a radian of the noise sphere of radius 1 / pi
+    auto chunk_job = job;
+    chunk_job.resolution = std::max(int(glm::pi<float>() * quads / size), 1);
+    int side = quads + 1;
+    std::vector<glm::vec3> dirs(side * side), gradients(side * side);
+    for (int r = 0; r < side; ++r) {
+        for (int c = 0; c < side; ++c) {
+            dirs[r * side + c] = glm::normalize(getCubeDirection(face, sc + size * c / quads, tc + size * r / quads));
+        }
     }
-    else if (x < 7 * m_resolution / 8) {
-        return palette[2];
+    std::vector<float> heights(side * side);
+    getHeightsForDirections(chunk_job, chunk_job.octaves(), dirs, heights.data(), gradients.data());
+
+    // On the sphere of radius 0.5 (1 + k h), the normal leans against the height's slope: it is
+    // d (1 + k h) - k g, where g is the tangential part of the height's gradient
+    std::vector<float> vertices;
+    vertices.reserve(side * side * 8);
+    float min_u = 1, max_u = 0;
+    for (int i = 0; i < side * side; ++i) {
+        auto &d = dirs[i];
+        auto g = gradients[i] - glm::dot(gradients[i], d) * d;
+        float lift = 1 + TERRAIN_RELIEF * heights[i];
+        auto position = 0.5f * lift * d;
+        auto normal = glm::normalize(lift * d - TERRAIN_RELIEF * g);
+        auto uv = TextureMap::getUVAt(0.5f * d, PrimitiveType::PRIMITIVE_SPHERE);
+        min_u = std::min(min_u, uv.x);
+        max_u = std::max(max_u, uv.x);
+        vertices.insert(vertices.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z, uv.x, uv.y });
     }
-    else {
-        return palette[3];
+
+    // A square across the uv seam continues past u = 1 rather than wrapping back to 0
+    if (max_u - min_u > 0.5f) {
+        for (int i = 0; i < side * side; ++i) {
+            if (vertices[i * 8 + 6] < 0.5f) vertices[i * 8 + 6] += 1;
+        }
     }
+    return vertices;
+}
+
+float TerrainGenerator::getHeight(const NoiseTable &noise, float x, float y) const {
+    // Task 6: modify this call to produce noise of a different frequency
+    float z = 1.f/2 * computePerlin(noise, x * 2, y * 2);
+
+    // Task 7: combine multiple different octaves of noise to produce fractal perlin noise
+    z += 1.f/4 * computePerlin(noise, x * 4, y * 4);
+    z += 1.f/8 * computePerlin(noise, x * 8, y * 8);
+    z += 1.f/16 * computePerlin(noise, x * 16, y * 16);
+
+    // Return 0 as placeholder
+    return z;
 }
 
-float TerrainGenerator::getBezierCurve(float p0, float p1, float p2, float t) {
-    return (1-t) * (1-t) * p0 + 2 * (1-t) * t * p1 + t*t * p2;
+float TerrainGenerator::computePerlin(const NoiseTable &noise, float x, float y) const {
+    // Scalar reference, PerlinKernel::heightRow() batches the same computation per row
+    return PerlinKernel::perlin(noise, x, y);
 }
 
+float TerrainGenerator::computeSimplex(const NoiseTable &noise, float x, float y) const {
+    return SimplexKernel::simplex(noise, x, y);
+}
+
+void TerrainGenerator::getHeightsForDirections(const TerrainJob &job, const Octaves &octaves,
+                                               const std::vector<glm::vec3> &dirs, float *out,
+                                               glm::vec3 *gradients) const {
+    // A sphere of radius 1 / pi has the circumference, 2, that the 2:1 map spans in noise
+    // coordinates, so features keep their size
+    int count = dirs.size();
+    std::vector<float> x(count), y(count), z(count);
+    for (int i = 0; i < count; ++i) {
+        auto p = dirs[i] / glm::pi<float>();
+        x[i] = p.x;
+        y[i] = p.y;
+        z[i] = p.z;
+    }
+    auto craters = job.craters();
+    if (gradients == nullptr) {
+        NoiseKernel::heightPoints(job.basis, job.noise, octaves, x.data(), y.data(), z.data(), count, out);
+        CraterKernel::addPoints(job.noise, craters, x.data(), y.data(), z.data(), count, out);
+        return;
+    }
+
+    // Derivatives along the noise axes, scaled to be per unit of direction
+    std::vector<float> gx(count), gy(count), gz(count);
+    NoiseKernel::heightPoints(job.basis, job.noise, octaves, x.data(), y.data(), z.data(), count, out,
+                              gx.data(), gy.data(), gz.data());
+    CraterKernel::addPoints(job.noise, craters, x.data(), y.data(), z.data(), count, out,
+                            gx.data(), gy.data(), gz.data());
+    for (int i = 0; i < count; ++i) gradients[i] = glm::vec3(gx[i], gy[i], gz[i]) / glm::pi<float>();
+}
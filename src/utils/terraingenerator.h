@@ -2,9 +2,17 @@
 #define PROJECTS_REALTIME_TERRAINGENERATOR_H
 
 #include <vector>
+#include <cstdint>
 #include "glm/glm.hpp"
 #include <map>
+#include <string>
 #include <iostream>
+#include <memory>
+#include "utils/noisekernel.h"
+#include "utils/bandsynthesizer.h"
+#include "utils/paletteramp.h"
+#include "utils/biometable.h"
+#include "utils/craterkernel.h"
 
 enum PlanetType {
     PLANET_SUN,
@@ -13,53 +21,250 @@ enum PlanetType {
     PLANET_GAS,
 };
 
+// Texel layouts the generator emits, recorded in cached textures. The values are part of the cache
+// key, so they stay fixed.
+enum class TexelFormat {
+    RGBA8 = 1,  // 8 bits per channel, unsigned normalized; what color maps are generated as
+    RG8 = 2,    // two unsigned normalized channels; tangent-space normals, whose z is rebuilt on the GPU
+};
+
+// Everything needed to generate one color map. A job is fully determined by its name, seed,
+// resolution and the generator version, and is read-only once created, so any number of threads
+// can fill tiles of the same or different jobs at once.
+struct TerrainJob {
+    std::string name;
+    unsigned int seed = 0;
+    int resolution = 0;     // the map is (2 * resolution) x resolution texels
+    NoiseTable noise;
+    NoiseBasis basis = NoiseBasis::PERLIN;  // kernel the noise heights are sampled with
+    std::vector<glm::vec3> palette;
+    bool banded = false;
+
+    // The palette compiled for sampling noise heights, shared by the copies of a job
+    std::shared_ptr<const PaletteRamp> ramp;
+
+    // Land colors by climate, or null to color by height alone. Jobs with biomes evaluate
+    // temperature and moisture noise alongside the height, over the first BIOME_OCTAVES octaves.
+    std::shared_ptr<const BiomeTable> biomes;
+
+    // Crater layer added to the noise heights, see CraterKernel: craters are craterDepth times as
+    // deep as they are wide, and craterDensity of the cells of each scale hold one. 0 for none.
+    float craterDepth = 0;
+    float craterDensity = 0;
+
+    // Jobs with biomes or craters sample both layouts on the sphere, so that their 2:1 map shows
+    // the same planet, with round craters, as the cube map
+    bool sampledOnSphere() const { return biomes != nullptr || craterDepth > 0; };
+
+    // Generate a cube map instead: six square faces of resolution / 2 texels, which match the
+    // equatorial density of the 2:1 map, stacked as rows in GL face order +X, -X, +Y, -Y, +Z, -Z.
+    // The noise is sampled in 3D on the unit sphere, so there is no seam at all.
+    bool cubemap = false;
+
+    // Bands of a banded map, and the turbulence that bends them, see BandSynthesizer
+    std::vector<BandStop> bands = BandSynthesizer::defaultStops();
+    float turbulence = 0;
+
+    // Dimensions of the generated texel array, all faces included
+    int width() const { return cubemap ? resolution / 2 : resolution * 2; };
+    int height() const { return cubemap ? resolution / 2 * 6 : resolution; };
+
+    // Noise octaves resolved by the map's texels, which are 1 / resolution noise units apart in
+    // both layouts (at the equator of a cube map). The 2:1 map spans 2 noise units around the
+    // planet, and its noise repeats with that period, so its left and right edges join.
+    Octaves octaves() const {
+        auto octaves = Octaves::forSpacing(1.f / resolution);
+        octaves.wrap = 2;
+        return octaves;
+    };
+
+    // Crater scales resolved by the map's texels, likewise
+    Craters craters() const { return Craters::forSpacing(1.f / resolution, craterDepth, craterDensity); };
+};
+
+// A rectangle of a job's texel array. Tiles are generated independently of each other and in any
+// order, a tile's texels only depend on its position, and those of a cube map never straddle two
+// faces, so each can be uploaded with glTexSubImage2D as soon as it is done.
+struct TerrainTile {
+    int row;
+    int col;
+    int width;
+    int height;
+};
+
 class TerrainGenerator {
 public:
     TerrainGenerator();
     ~TerrainGenerator();
-    int getResolution() { return m_resolution; };
-    std::vector<float>& generateTerrainNormals();
-    std::vector<float>& generateTerrainColors(int type);
-    std::vector<float>& generateTerrainColors(PlanetType type);
-    std::vector<float>& generateTerrainDisplacement();
+    int getResolution() const { return m_resolution; };
 
-private:
-    std::vector<glm::vec2> m_randVecLookup;
-    int m_resolution;
-    int m_lookupSize;
-    std::vector<float> normals;
-    std::vector<float> colors;
-    std::vector<float> displacement;
-    std::map<int, std::vector<glm::vec3>> planet_color_palette;
+    // Returns the smallest resolution tier, a power of two from MIN_RESOLUTION up to getResolution(),
+    // whose color map still has a texel per pixel on a sphere covering screenDiameter pixels
+    int selectResolution(float screenDiameter) const;
+
+    // Bumped whenever a change alters the generated texels, so that cached textures are invalidated
+    inline static const int VERSION = 9;
+
+    inline static const int MIN_RESOLUTION = 64;
+
+    // Edge length of the tiles from createTiles(), smaller only where a cube face is
+    inline static const int TILE_SIZE = 64;
+
+    // Octaves of the temperature and moisture channels, which only vary on a continental scale
+    inline static const int BIOME_OCTAVES = 3;
 
+    // Crater layers of moons, and of rocky planets, whose craters are fewer and eroded shallower
+    inline static const float MOON_CRATER_DEPTH = 1.5f;
+    inline static const float MOON_CRATER_DENSITY = 0.5f;
+    inline static const float ROCKY_CRATER_DEPTH = 0.6f;
+    inline static const float ROCKY_CRATER_DENSITY = 0.15f;
 
-    // Samples the (infinite) random vector grid at (row, col)
-    glm::vec2 sampleRandomVector(int row, int col);
+    // Cloud layers: their noise's scale against the terrain's, octaves at most, and the noise value
+    // at which coverage starts and the range over which it then rises to full, for soft edges
+    inline static const float CLOUD_SCALE = 2.f;
+    inline static const int CLOUD_OCTAVES = 5;
+    inline static const float CLOUD_THRESHOLD = 0.f;
+    inline static const float CLOUD_SOFTNESS = 0.12f;
 
-    // Takes a grid coordinate (row, col), [0, m_resolution), which describes a vertex in a plane mesh
-    // Returns a normalized position (x, y, z); x and y in range from [0, 1), and z is obtained from getHeight()
-    glm::vec3 getPosition(int row, int col);
+    // Scale of the noise heights relative to the radius for displaced surfaces, which keeps
+    // mountains within a few percent of it
+    inline static const float TERRAIN_RELIEF = 0.06f;
+
+    // Scale of the noise heights relative to the sphere for normal maps. Taken literally, the
+    // noise would rise a third of the planet's radius; this flattens it to rolling terrain.
+    inline static const float NORMAL_RELIEF = 0.25f;
+
+    // Derive the noise table and palette from the seed, for a fixed palette index or a planet type.
+    // The noise is defined in normalized coordinates, so the same seed at a lower resolution is a
+    // downsampled preview of the same map. A resolution of 0 selects getResolution().
+    TerrainJob createJob(int type, unsigned int seed, int resolution = 0) const;
+    TerrainJob createJob(PlanetType type, unsigned int seed, int resolution = 0) const;
+
+    // Noise basis of the jobs createJob() makes for a planet type. Maps of a basis other than Perlin
+    // carry it in their name, so that cached maps of either basis are told apart.
+    void setNoiseBasis(PlanetType type, NoiseBasis basis) { m_noise_bases[type] = basis; };
+    NoiseBasis getNoiseBasis(PlanetType type) const { return m_noise_bases.at(type); };
+
+    // Band tables of a banded job at its resolution
+    BandSynthesizer createBands(const TerrainJob &job) const;
+
+    // Splits the job's texel array into tiles of at most TILE_SIZE x TILE_SIZE, row by row
+    std::vector<TerrainTile> createTiles(const TerrainJob &job) const;
+
+    // Fills a tile of the job's RGBA8 color map; out points at the tile's first texel, 4 bytes per
+    // texel, and its rows are stride bytes apart (0 for tightly packed). Each texel is written
+    // exactly once, so out can be memory the caller hands straight to the GPU or to disk, e.g. a
+    // mapped pixel buffer or cache file. bands is createBands(job) for banded jobs, built once and
+    // shared by all of the job's tiles, and may be null otherwise. Safe to call concurrently.
+    void generateColorTile(const TerrainJob &job, const BandSynthesizer *bands, const TerrainTile &tile,
+                           std::uint8_t *out, std::size_t stride = 0) const;
+
+    // Fills rows [rowBegin, rowEnd) of the color map, as one full-width tile; out points at row 0
+    // of the whole map. Rows of a cube map range over all its faces, up to job.height().
+    void generateColorRows(const TerrainJob &job, int rowBegin, int rowEnd,
+                           std::uint8_t *out, std::size_t stride = 0) const;
+
+    // Fills rows [rowBegin, rowEnd) of the job's RG8 normal map, (2 * resolution) x resolution
+    // texels over the sphere's uv mapping in either layout, 2 bytes per texel: the tangent-space
+    // normal's x (along u) and y (along v) mapped to [0, 1]. Each normal comes from the analytic
+    // gradient of the noise at its texel, evaluated with the height in one pass, so rows are
+    // independent of each other. Banded jobs have no relief and get flat normals.
+    void generateNormalRows(const TerrainJob &job, int rowBegin, int rowEnd,
+                            std::uint8_t *out, std::size_t stride = 0) const;
+
+    // Direction from the cube's center through the point (sc, tc) in [-1, 1] of a cube map face,
+    // inverting the face selection of GL cube map sampling
+    static glm::vec3 getCubeDirection(int face, float sc, float tc);
+
+    // Fills a size x size page of one face of the job's cube map as it would be at faceSize texels
+    // per face, from texel (row, col) of the face on, with the octaves and craters that density
+    // resolves; 4 bytes per texel. The page may reach past the face's edges, whose texels continue
+    // along the directions beyond them, so a page can carry a border of texels for filtering.
+    // Cube maps of banded jobs are looked up in their bands instead and have no pages.
+    void generateCubePage(const TerrainJob &job, int faceSize, int face, int row, int col, int size,
+                          std::uint8_t *out, std::size_t stride = 0) const;
+
+    // Job of a planet's animated cloud layer, a 2:1 map of simplex noise on the sphere
+    TerrainJob createCloudJob(unsigned int seed, int resolution = 0) const;
+
+    // Fills rows [rowBegin, rowEnd) of the cloud job's R8 coverage at `time`, (2 * resolution) x
+    // resolution texels over the sphere's uv mapping, 1 byte per texel; out points at row 0 of the
+    // whole map. As time advances, the noise moves through the sphere along its axis, so clouds
+    // form and dissolve rather than slide, and maps of nearby times differ little, so a layer can
+    // be regenerated a few rows at a time and blended between two times. Rows are independent.
+    void generateCloudRows(const TerrainJob &job, float time, int rowBegin, int rowEnd,
+                           std::uint8_t *out, std::size_t stride = 0) const;
+
+    // Noise heights of the job at points on the unit sphere, craters included, the same that color
+    // its cube map, evaluated as one batch. If gradients is not null, it receives each height's derivative
+    // with respect to the direction, in the same evaluation; its tangential part is the slope
+    // along the surface, e.g. for normals of a mesh displaced by the heights.
+    void getHeightsForDirections(const TerrainJob &job, const Octaves &octaves, const std::vector<glm::vec3> &dirs,
+                                 float *out, glm::vec3 *gradients = nullptr) const;
+
+    // Vertices of the job's displaced surface over a square of a cube face, from (sc, tc) to
+    // (sc + size, tc + size) in the face's [-1, 1] coordinates, (quads + 1)^2 of them row by row.
+    // Each is 8 floats laid out as the shapes' meshes: its position on the sphere of diameter 1
+    // raised by TERRAIN_RELIEF times the noise height there, its normal, which follows the
+    // height's analytic gradient, and its uv over the sphere's mapping. Heights include the
+    // octaves and craters the vertex spacing resolves, so coarser squares are smoother.
+    std::vector<float> generateTerrainDisplacement(const TerrainJob &job, int face, float sc, float tc,
+                                                   float size, int quads) const;
+
+    // Whole maps, written into caller memory or returned in a new vector. Normal maps are always
+    // (2 * resolution) x resolution RG8 texels.
+    void generateTerrainColors(const TerrainJob &job, std::uint8_t *out, std::size_t stride = 0) const;
+    void generateTerrainNormals(const TerrainJob &job, std::uint8_t *out, std::size_t stride = 0) const;
+    std::vector<std::uint8_t> generateTerrainNormals(const TerrainJob &job) const;
+    std::vector<std::uint8_t> generateTerrainColors(int type, unsigned int seed) const;
+    std::vector<std::uint8_t> generateTerrainColors(PlanetType type, unsigned int seed) const;
+    std::vector<std::uint8_t> generateTerrainColors(const TerrainJob &job) const;
+
+    // Scalar samplers, the reference for the batched row kernels (and timed by terrainbenchmark)
 
     // Takes a normalized (x, y) position, in range [0,1)
     // Returns a height value, z, by sampling a noise function
-    float getHeight(float x, float y);
+    float getHeight(const NoiseTable &noise, float x, float y) const;
 
-    // Computes the normal of a vertex by averaging neighbors
-    glm::vec3 getNormal(int row, int col);
+    // Computes the intensity of Perlin noise at some point
+    float computePerlin(const NoiseTable &noise, float x, float y) const;
 
-    // Computes color of vertex using normal and, optionally, position
-    glm::vec3 getColorFromPerlin(glm::vec3 position, std::vector<glm::vec3> &palette);
+    // Computes the intensity of simplex noise at some point, on the same gradients
+    float computeSimplex(const NoiseTable &noise, float x, float y) const;
 
-    // Computes the intensity of Perlin noise at some point
-    float computePerlin(float x, float y);
+private:
+    // Four colors each, from the lowest heights to the highest, see https://imgur.com/a/OCCq2gl
+    static constexpr int PALETTE_COUNT = 10;
+    static constexpr float PALETTES[PALETTE_COUNT][4][3] = {
+        {{0.97, 0.43, 0.10}, {0.95, 0.36, 0.14}, {0.99, 0.73, 0.00}, {1.00, 0.91, 0.55}},   // Sun
+        {{0.35, 0.35, 0.34}, {0.75, 0.74, 0.74}, {0.55, 0.54, 0.53}, {0.96, 0.96, 0.97}},   // Mercury
+        {{0.75, 0.77, 0.78}, {0.85, 0.69, 0.57}, {0.96, 0.86, 0.77}, {0.97, 0.99, 0.99}},   // Venus
+        {{0.12, 0.22, 0.44}, {0.85, 0.75, 0.64}, {0.22, 0.44, 0.38}, {0.95, 0.98, 0.97}},   // Earth
+        {{0.55, 0.36, 0.29}, {0.95, 0.48, 0.37}, {0.76, 0.43, 0.36}, {0.85, 0.74, 0.62}},   // Mars
+        {{0.60, 0.45, 0.07}, {0.75, 0.51, 0.22}, {0.75, 0.69, 0.61}, {0.65, 0.44, 0.36}},   // Jupiter
+        {{0.95, 0.81, 0.53}, {0.85, 0.72, 0.47}, {0.62, 0.58, 0.44}, {0.75, 0.64, 0.50}},   // Saturn
+        {{0.64, 0.80, 0.82}, {0.66, 0.82, 0.84}, {0.71, 0.86, 0.87}, {0.82, 0.94, 0.94}},   // Uranus
+        {{0.37, 0.38, 0.60}, {0.40, 0.48, 0.65}, {0.45, 0.58, 0.75}, {0.47, 0.62, 0.75}},   // Neptune
+        {{0.84, 0.70, 0.73}, {0.66, 0.62, 0.59}, {0.96, 0.92, 0.87}, {0.25, 0.17, 0.09}},   // Moon
+    };
+    static std::vector<glm::vec3> getPalette(int index);
+
+    int m_resolution;
+    std::map<int, std::shared_ptr<const PaletteRamp>> m_palette_ramps;  // of the fixed palettes
+    std::map<int, NoiseBasis> m_noise_bases;                            // by planet type
 
-    glm::vec3 getColorForRing(int x, int y, std::vector<glm::vec3> &palette);
+    // Fills a tile of a cube map, or of a 2:1 map sampled on the sphere, from the texels'
+    // directions: the heights plus craters, and with biomes also temperature and moisture,
+    // evaluated in one pass
+    void generateSphereTile(const TerrainJob &job, const TerrainTile &tile, std::uint8_t *out, std::size_t stride) const;
 
-    // Quadratic, 1-d (input x and y separately)
-    float getBezierCurve(float p0, float p1, float p2, float t);
+    // Colors count texels from their points on the noise sphere, likewise, with the job's
+    // TerrainPipeline kernel for the octaves if it has one
+    void shadeSphereRow(const TerrainJob &job, const Octaves &octaves, const Craters &craters, NoisePointsKernel kernel,
+                        const float *x, const float *y, const float *z, int count, std::uint8_t *out) const;
 
-    // Update the perlin noise map
-    void updateNoise();
+    // Draw a new perlin noise map
+    NoiseTable createNoise(unsigned int seed) const;
 };
 
 
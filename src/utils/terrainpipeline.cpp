@@ -0,0 +1,25 @@
+#include "utils/terrainpipeline.h"
+
+template <PlanetType TYPE>
+bool TerrainPipeline::matches(const TerrainJob &job) {
+    int channels = job.biomes != nullptr ? 3 : 1;
+    return job.basis == PlanetTraits<TYPE>::BASIS && channels == PlanetTraits<TYPE>::CHANNELS;
+}
+
+template <PlanetType TYPE>
+NoisePointsKernel TerrainPipeline::kernel(int octaves) {
+    using Traits = PlanetTraits<TYPE>;
+    if constexpr (Traits::BASIS == NoiseBasis::SIMPLEX) {
+        return SimplexKernel::unrolledPoints<Traits::CHANNELS, Traits::CHANNEL_OCTAVES>(octaves);
+    } else {
+        return PerlinKernel::unrolledPoints<Traits::CHANNELS, Traits::CHANNEL_OCTAVES>(octaves);
+    }
+}
+
+NoisePointsKernel TerrainPipeline::select(const TerrainJob &job, const Octaves &octaves) {
+    if (job.banded) return nullptr;
+    if (matches<PLANET_SUN>(job)) return kernel<PLANET_SUN>(octaves.count);
+    if (matches<PLANET_MOON>(job)) return kernel<PLANET_MOON>(octaves.count);
+    if (matches<PLANET_ROCKY>(job)) return kernel<PLANET_ROCKY>(octaves.count);
+    return nullptr;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "utils/terraingenerator.h"
+
+// How each planet type's noise is generated, fixed at compile time: its basis, and how many
+// channels are evaluated with the height, the extra ones over the first CHANNEL_OCTAVES octaves.
+// Gas giants are banded and have no noise kernel.
+template <PlanetType TYPE>
+struct PlanetTraits;
+
+template <>
+struct PlanetTraits<PLANET_SUN> {
+    static constexpr NoiseBasis BASIS = NoiseBasis::PERLIN;
+    static constexpr int CHANNELS = 1;
+    static constexpr int CHANNEL_OCTAVES = 0;
+};
+
+template <>
+struct PlanetTraits<PLANET_MOON> {
+    static constexpr NoiseBasis BASIS = NoiseBasis::SIMPLEX;
+    static constexpr int CHANNELS = 1;
+    static constexpr int CHANNEL_OCTAVES = 0;
+};
+
+// Height, temperature and moisture, see BiomeTable
+template <>
+struct PlanetTraits<PLANET_ROCKY> {
+    static constexpr NoiseBasis BASIS = NoiseBasis::SIMPLEX;
+    static constexpr int CHANNELS = 3;
+    static constexpr int CHANNEL_OCTAVES = TerrainGenerator::BIOME_OCTAVES;
+};
+
+// Noise kernels specialized per planet type and octave count. Where NoiseKernel dispatches on the
+// basis and loops over the octaves in every call, each of these is compiled for one combination,
+// with the octave loop unrolled and the gradient table's mask an immediate, and is selected once
+// per tile or page. The results match NoiseKernel's exactly; the build turns off FMA contraction,
+// which would otherwise fuse multiplies and adds differently in the two.
+class TerrainPipeline {
+public:
+    // The kernel for the job's heights, and its climate channels if it has biomes, over the first
+    // octaves.count octaves; null if the job's basis and channels are those of no planet type's
+    // traits (e.g. after TerrainGenerator::setNoiseBasis()), which leaves it to NoiseKernel
+    static NoisePointsKernel select(const TerrainJob &job, const Octaves &octaves);
+
+private:
+    template <PlanetType TYPE>
+    static bool matches(const TerrainJob &job);
+
+    template <PlanetType TYPE>
+    static NoisePointsKernel kernel(int octaves);
+};
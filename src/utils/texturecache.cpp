@@ -0,0 +1,140 @@
+#include "utils/texturecache.h"
+
+#include <QDir>
+#include <QStandardPaths>
+#include <cstdint>
+#include <cstring>
+
+// Layout of the file itself, independent of the generator version
+static const uint32_t CACHE_LAYOUT = 1;
+
+// Texel data starts at a fixed, aligned offset after the header
+static const qint64 DATA_OFFSET = 64;
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t layout;
+    uint32_t version;
+    uint32_t seed;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t reserved;
+    uint64_t size;
+};
+
+static_assert(sizeof(CacheHeader) <= DATA_OFFSET, "cache header must fit before the texel data");
+
+static CacheHeader makeHeader(const TextureCache::Key &key, qint64 size) {
+    CacheHeader header {};
+    std::memcpy(header.magic, "PTEX", 4);
+    header.layout = CACHE_LAYOUT;
+    header.version = key.version;
+    header.seed = key.seed;
+    header.width = key.width;
+    header.height = key.height;
+    header.format = key.format;
+    header.size = size;
+    return header;
+}
+
+TextureCache::Entry::~Entry() {
+    if (m_map != nullptr) m_file.unmap(m_map);
+
+    // Discard a created entry that was never committed
+    if (!m_path.isEmpty()) {
+        m_file.close();
+        m_file.remove();
+    }
+}
+
+bool TextureCache::Entry::commit() {
+    if (m_path.isEmpty()) return false;
+
+    // Readers only ever open the final name, so they never see a partially written entry
+    m_file.unmap(m_map);
+    m_map = nullptr;
+    m_data = nullptr;
+    m_file.close();
+    QFile::remove(m_path);
+    if (!m_file.rename(m_path)) {
+        m_file.remove();
+        m_path.clear();
+        return false;
+    }
+    m_path.clear();
+
+    // Map the published file again; its pages are still cached, so this doesn't read them back
+    if (!m_file.open(QIODevice::ReadOnly)) return false;
+    m_map = m_file.map(0, DATA_OFFSET + m_size);
+    if (m_map == nullptr) return false;
+    m_data = m_map + DATA_OFFSET;
+    return true;
+}
+
+TextureCache::TextureCache(QString directory) {
+    if (directory.isEmpty()) {
+        directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/planet_textures";
+    }
+    m_directory = directory;
+    QDir().mkpath(m_directory);
+}
+
+QString TextureCache::pathFor(const Key &key) const {
+    return QString("%1/%2_s%3_%4x%5_f%6_v%7.ptex")
+            .arg(m_directory, QString::fromStdString(key.name))
+            .arg(key.seed)
+            .arg(key.width)
+            .arg(key.height)
+            .arg(key.format)
+            .arg(key.version);
+}
+
+std::unique_ptr<TextureCache::Entry> TextureCache::load(const Key &key, qint64 size) {
+    auto entry = std::make_unique<Entry>();
+    entry->m_file.setFileName(pathFor(key));
+
+    if (!entry->m_file.open(QIODevice::ReadOnly) || entry->m_file.size() != DATA_OFFSET + size) {
+        m_misses += 1;
+        return nullptr;
+    }
+
+    entry->m_map = entry->m_file.map(0, DATA_OFFSET + size);
+    if (entry->m_map == nullptr) {
+        m_misses += 1;
+        return nullptr;
+    }
+
+    // The file name encodes the key, the header guards against truncated or foreign files
+    auto expected = makeHeader(key, size);
+    if (std::memcmp(entry->m_map, &expected, sizeof(CacheHeader)) != 0) {
+        m_misses += 1;
+        return nullptr;
+    }
+
+    entry->m_data = entry->m_map + DATA_OFFSET;
+    entry->m_size = size;
+    m_hits += 1;
+    return entry;
+}
+
+std::unique_ptr<TextureCache::Entry> TextureCache::create(const Key &key, qint64 size) {
+    auto entry = std::make_unique<Entry>();
+    entry->m_path = pathFor(key);
+    entry->m_file.setFileName(entry->m_path + ".part");
+
+    if (!entry->m_file.open(QIODevice::ReadWrite | QIODevice::Truncate) || !entry->m_file.resize(DATA_OFFSET + size)) {
+        return nullptr;
+    }
+
+    entry->m_map = entry->m_file.map(0, DATA_OFFSET + size);
+    if (entry->m_map == nullptr) return nullptr;
+
+    // The header goes in up front, the texels are filled in by the caller
+    auto header = makeHeader(key, size);
+    std::memset(entry->m_map, 0, DATA_OFFSET);
+    std::memcpy(entry->m_map, &header, sizeof(CacheHeader));
+    entry->m_data = entry->m_map + DATA_OFFSET;
+    entry->m_size = size;
+    return entry;
+}
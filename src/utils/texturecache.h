@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <memory>
+#include <string>
+
+// Versioned on-disk cache of generated textures. Every entry is one binary file holding a small
+// header followed by the raw texel data. Entries are memory-mapped on load, so a cache hit can be
+// uploaded to the GPU straight from the mapping without reading it into a buffer first.
+class TextureCache {
+public:
+    // Everything that determines the texels of a cached texture
+    struct Key {
+        std::string name;       // what was generated, e.g. the palette or planet type
+        unsigned int seed;
+        int width;
+        int height;
+        int format;             // TexelFormat of the data
+        int version;            // generator version
+    };
+
+    // A mapped cache entry; data() stays valid while the entry is alive. Entries from create()
+    // are writable and private to the caller until commit() publishes them.
+    class Entry {
+    public:
+        ~Entry();
+        const void *data() const { return m_data; };
+        void *data() { return m_data; };
+        qint64 size() const { return m_size; };
+
+        // Moves a created entry into place, after which data() is a read-only view of the
+        // published file; returns false, and leaves no entry behind, on failure
+        bool commit();
+
+    private:
+        friend class TextureCache;
+        QFile m_file;
+        QString m_path;         // where commit() publishes a created entry, empty once published
+        uchar *m_map = nullptr;
+        uchar *m_data = nullptr;
+        qint64 m_size = 0;
+    };
+
+    // Uses the per-user cache location if no directory is given
+    explicit TextureCache(QString directory = QString());
+
+    // Maps the entry for key, or returns nullptr (and counts a miss) if it is absent or stale
+    std::unique_ptr<Entry> load(const Key &key, qint64 size);
+
+    // Creates a mapped, writable entry for key with room for size bytes of texels, so that they can
+    // be generated in place; returns nullptr if the cache directory is not writable
+    std::unique_ptr<Entry> create(const Key &key, qint64 size);
+
+    int getHits() const { return m_hits; };
+    int getMisses() const { return m_misses; };
+    void resetStats() { m_hits = 0; m_misses = 0; };
+
+private:
+    QString m_directory;
+    int m_hits = 0;
+    int m_misses = 0;
+
+    QString pathFor(const Key &key) const;
+};
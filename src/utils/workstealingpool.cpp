@@ -0,0 +1,83 @@
+#include "utils/workstealingpool.h"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads <= 0) threads = std::max(1, (int)std::thread::hardware_concurrency() - 1);
+    for (int i = 0; i < threads; ++i) m_queues.push_back(std::make_unique<Queue>());
+    for (int i = 0; i < threads; ++i) m_threads.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto &thread: m_threads) thread.join();
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    auto &queue = *m_queues[m_next++ % m_queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending += 1;
+        m_queued += 1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [&]() { return m_pending == 0; });
+}
+
+bool WorkStealingPool::pop(int index, std::function<void()> &task) {
+    // Own queue from the front, the others from the back, so a thief takes the work its owner
+    // would get to last
+    int count = int(m_queues.size());
+    bool found = false;
+    for (int k = 0; k < count && !found; ++k) {
+        auto &queue = *m_queues[(index + k) % count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (k == 0) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        } else {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        found = true;
+    }
+    if (found) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queued -= 1;
+    }
+    return found;
+}
+
+void WorkStealingPool::run(int index) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stop || m_queued > 0; });
+            if (m_stop) return;
+        }
+
+        // Another worker may take the task first, or it is counted but not queued just yet
+        std::function<void()> task;
+        if (!pop(index, task)) {
+            std::this_thread::yield();
+            continue;
+        }
+        task();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_pending == 0) m_idle.notify_all();
+    }
+}
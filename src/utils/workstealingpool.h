@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads, each with its own task queue. Submitted tasks are dealt to the
+// queues in turn; a worker runs its own tasks oldest first and, once out of work, steals the newest
+// task of another worker. Tasks of uneven cost, such as tiles of maps of different sizes, thus keep
+// every thread busy until the last one is taken.
+class WorkStealingPool {
+public:
+    // Uses all hardware threads but one if threads is 0
+    explicit WorkStealingPool(int threads = 0);
+
+    // Waits for the running tasks to finish and drops the queued ones
+    ~WorkStealingPool();
+
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished
+    void wait();
+
+    int getThreadCount() const { return int(m_queues.size()); };
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void run(int index);
+    bool pop(int index, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::atomic<int> m_next = 0;                // queue the next submitted task goes to
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;             // workers wait here while all queues are empty
+    std::condition_variable m_idle;             // wait() waits here for m_pending to drop to 0
+    int m_pending = 0;                          // submitted tasks not yet finished, guarded by m_mutex
+    int m_queued = 0;                           // submitted tasks not yet started, guarded by m_mutex
+    bool m_stop = false;                        // guarded by m_mutex
+};